@@ -0,0 +1,48 @@
+#!/usr/bin/env python3
+# Generates a Decaf program that stresses subtype tests: a deep chain of
+# classes, a wide set of interfaces, and many object assignments that
+# each need an IsChildOf check.
+#
+#   gen_hierarchy.py [DEPTH [INTERFACES [ASSIGNS]]] > h.decaf
+#   time ../src/main < h.decaf > /dev/null
+#
+# Defaults: a 1000-deep chain, 200 interfaces with every fifth class
+# implementing three of them, and 60000 assignments.
+import sys
+
+depth = int(sys.argv[1]) if len(sys.argv) > 1 else 1000
+nifaces = int(sys.argv[2]) if len(sys.argv) > 2 else 200
+nassigns = int(sys.argv[3]) if len(sys.argv) > 3 else 60000
+
+out = []
+for i in range(nifaces):
+    out.append('interface I%d { int m%d(); }' % (i, i))
+
+impls = {}
+for c in range(depth):
+    ext = ' extends C%d' % (c - 1) if c else ''
+    ifs = []
+    if c % 5 == 0:
+        ifs = [(c // 5 * 3 + k) % nifaces for k in range(3)]
+        impls[c] = ifs
+    imp = ' implements ' + ', '.join('I%d' % i for i in ifs) if ifs else ''
+    body = ['int f%d;' % c]
+    body += ['int m%d() { return %d; }' % (i, c) for i in ifs]
+    out.append('class C%d%s%s { %s }' % (c, ext, imp, ' '.join(body)))
+
+# every variable holds an object of the deepest class; assignments go
+# to a class or interface somewhere above it
+stmts = ['C%d leaf;' % (depth - 1)]
+stmts += ['C%d c%d;' % (c, c) for c in range(0, depth, 50)]
+iface_vars = sorted(set(i for ifs in impls.values() for i in ifs))
+stmts += ['I%d i%d;' % (i, i) for i in iface_vars]
+stmts.append('leaf = new C%d;' % (depth - 1))
+for n in range(nassigns):
+    if n % 2:
+        c = (n * 50) % depth // 50 * 50
+        stmts.append('c%d = leaf;' % c)
+    else:
+        i = iface_vars[n // 2 % len(iface_vars)]
+        stmts.append('i%d = leaf;' % i)
+out.append('void main() { %s }' % ' '.join(stmts))
+print('\n'.join(out))
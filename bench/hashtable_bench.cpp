@@ -0,0 +1,100 @@
+// Microbenchmark for Hashtable (src/ds.h) against the std::multimap it
+// replaced, at symbol table sizes from one scope to a large program.
+// Also times scope-style churn: entering and removing shadowing names.
+//
+//   g++ -O2 -DNDEBUG -I../src hashtable_bench.cpp ../src/intern.cpp \
+//       ../src/arena.cpp -o hashtable_bench && ./hashtable_bench
+
+#include <stdio.h>
+#include <time.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "ds.h"
+#include "intern.h"
+
+struct Decl {
+    int id;
+};
+
+// What Hashtable used to be: a multimap from copied keys, newest
+// binding found by walking the equal range.
+class MultimapTable {
+private:
+    std::multimap<std::string, Decl *> mm;
+
+public:
+    void Enter(const char *key, Decl *d) { mm.insert(std::make_pair(key, d)); }
+
+    Decl *Lookup(const char *key) {
+        std::multimap<std::string, Decl *>::iterator it = mm.upper_bound(key);
+        if (mm.count(key) == 0) return NULL;
+        return (--it)->second;
+    }
+};
+
+static double Now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+template<class Table>
+static void Run(const char *name, const std::vector<const char *> &keys,
+                std::vector<Decl> &decls, int rounds) {
+    int n = keys.size();
+    Table *t = NULL;
+    double start = Now();
+    for (int r = 0; r < rounds; r++) {
+        delete t;
+        t = new Table;
+        for (int i = 0; i < n; i++) t->Enter(keys[i], &decls[i]);
+    }
+    double mid = Now();
+    long hits = 0;
+    for (int r = 0; r < 10 * rounds; r++)
+        for (int i = 0; i < n; i++) hits += t->Lookup(keys[i]) != NULL;
+    double end = Now();
+    delete t;
+    printf("%-9s %7d keys  insert %7.2f Mops/s  lookup %7.2f Mops/s  (%ld)\n",
+           name, n, (double) n * rounds / (mid - start) / 1e6,
+           (double) n * rounds * 10 / (end - mid) / 1e6, hits);
+}
+
+// Each round shadows every fifth name and removes the bindings again,
+// the way entering and leaving a block scope does.
+static void Churn(const std::vector<const char *> &keys,
+                  std::vector<Decl> &decls, int rounds) {
+    Hashtable<Decl *> t;
+    int n = keys.size();
+    for (int i = 0; i < n; i++) t.Enter(keys[i], &decls[i]);
+    Decl inner = {-1};
+    double start = Now();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = r % 5; i < n; i += 5) t.Enter(keys[i], &inner, false);
+        for (int i = r % 5; i < n; i += 5) t.Remove(keys[i], &inner);
+    }
+    double end = Now();
+    printf("churn     %7d keys  %7.2f Mops/s  %d live entries\n", n,
+           2.0 * (n / 5) * rounds / (end - start) / 1e6, t.NumEntries());
+}
+
+int main() {
+    int sizes[] = {100, 5000, 100000};
+    for (int s = 0; s < 3; s++) {
+        int n = sizes[s];
+        std::vector<const char *> keys;
+        std::vector<Decl> decls(n);
+        char buf[32];
+        for (int i = 0; i < n; i++) {
+            sprintf(buf, "member_field_%d", i * 7919 % 1000003);
+            keys.push_back(Intern(buf));
+            decls[i].id = i;
+        }
+        int rounds = 2000000 / n;
+        Run<MultimapTable>("multimap", keys, decls, rounds);
+        Run<Hashtable<Decl *> >("Hashtable", keys, decls, rounds);
+        Churn(keys, decls, rounds * 5);
+    }
+    return 0;
+}
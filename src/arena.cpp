@@ -0,0 +1,40 @@
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+
+Arena nodeArena;
+
+
+void Arena::NewBlock(size_t minSize) {
+    size_t size = minSize + sizeof(Block) > BlockSize
+                  ? minSize + sizeof(Block) : BlockSize;
+    // blocks start zeroed: several nodes leave members to be filled in
+    // by later passes and test them against NULL before then
+    Block *b = (Block *) calloc(1, size);
+    b->next = blocks;
+    blocks = b;
+    cur = (char *) b + ((sizeof(Block) + 7) & ~(size_t) 7);
+    end = (char *) b + size;
+    numBlocks++;
+}
+
+
+char *Arena::StrDup(const char *str) {
+    size_t len = strlen(str) + 1;
+    char *s = (char *) Alloc(len);
+    memcpy(s, str, len);
+    return s;
+}
+
+
+void Arena::FreeAll() {
+    while (blocks) {
+        Block *next = blocks->next;
+        free(blocks);
+        blocks = next;
+    }
+    cur = end = NULL;
+}
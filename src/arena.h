@@ -0,0 +1,77 @@
+
+
+#ifndef _H_arena
+#define _H_arena
+
+#include <stddef.h>
+
+class Arena {
+private:
+    static const size_t BlockSize = 256 * 1024;
+
+    struct Block {
+        Block *next;
+    };
+
+    Block *blocks;
+    char *cur, *end;
+    long numAllocs;
+    long numBlocks;
+
+    void NewBlock(size_t minSize);
+
+public:
+    constexpr Arena() : blocks(NULL), cur(NULL), end(NULL),
+                        numAllocs(0), numBlocks(0) {}
+
+    void *Alloc(size_t size) {
+        size = (size + 7) & ~(size_t) 7;
+        if (size > (size_t) (end - cur)) NewBlock(size);
+        void *p = cur;
+        cur += size;
+        numAllocs++;
+        return p;
+    }
+
+    char *StrDup(const char *str);
+
+    void FreeAll();
+
+    long NumAllocs() const { return numAllocs; }
+
+    long NumBlocks() const { return numBlocks; }
+};
+
+
+template<class T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+
+    ArenaAllocator() {}
+
+    template<class U>
+    ArenaAllocator(const ArenaAllocator<U> &) {}
+
+    T *allocate(size_t n);
+
+    void deallocate(T *p, size_t n) {}
+
+    template<class U>
+    bool operator==(const ArenaAllocator<U> &) const { return true; }
+
+    template<class U>
+    bool operator!=(const ArenaAllocator<U> &) const { return false; }
+};
+
+
+// Holds the AST, its locations and lists for the whole compilation; it is
+// constant-initialized so nodes built during static initialization can use it.
+extern Arena nodeArena;
+
+template<class T>
+T *ArenaAllocator<T>::allocate(size_t n) {
+    return (T *) nodeArena.Alloc(n * sizeof(T));
+}
+
+#endif
@@ -5,27 +5,35 @@
 #include <stdio.h>
 #include "globals.h"
 #include "ds.h"
+#include "intern.h"
+#include "optimizer.h"
 #include <iostream>
 
 
 CodeGenerator *CG = new CodeGenerator();
 
 Node::Node(yyltype loc) {
-    location = new yyltype(loc);
+    kind = NK_Node;
+    location = (yyltype *) nodeArena.Alloc(sizeof(yyltype));
+    *location = loc;
     parent = NULL;
 }
 
 Node::Node() {
+    kind = NK_Node;
     location = NULL;
     parent = NULL;
 }
 
 
 Identifier::Identifier(yyltype loc, const char *n) : Node(loc) {
-    name = strdup(n);
+    kind = NK_Identifier;
+    name = n;
 }
 
 void Identifier::CheckDecl() {
+    if (decl) return;
+
     Decl *d = scopeHandler->Lookup(this);
     if (d == NULL) {
         semantic_error = 1;
@@ -42,9 +50,7 @@ void Identifier::Check(checkStep c) {
 }
 
 bool Identifier::IsEquivalentTo(Identifier *other) {
-    bool eq = false;
-    if (!strcmp(name, other->GetIdName())) eq = true;
-    return eq;
+    return name == other->GetIdName();
 }
 
 void Identifier::Emit() {
@@ -55,7 +61,8 @@ void Identifier::Emit() {
 void Identifier::AddPrefix(const char *prefix) {
     char *s = (char *) malloc(strlen(name) + strlen(prefix) + 1);
     sprintf(s, "%s%s", prefix, name);
-    name = s;
+    name = Intern(s);
+    free(s);
 }
 
 
@@ -68,6 +75,7 @@ Decl::Decl(Identifier *n) : Node(*n->GetLocation()) {
 
 
 VariableDecl::VariableDecl(Identifier *n, Type *t) : Decl(n) {
+    kind = NK_VariableDecl;
 
     (type = t)->SetParent(this);
     class_member_ofst = -1;
@@ -102,6 +110,10 @@ void VariableDecl::Check(checkStep c) {
     }
 }
 
+bool VariableDecl::IsClassMember() {
+    return isa<ClassDecl>(parent);
+}
+
 void VariableDecl::AssignOffset() {
     if (this->IsGlobal()) {
         asm_loc = new Location(gpRelative, CG->GetNextGlobalLoc(),
@@ -129,6 +141,7 @@ void VariableDecl::Emit() {
 }
 
 ClassDecl::ClassDecl(Identifier *n, NamedType *ex, List<NamedType *> *imp, List<Decl *> *m) : Decl(n) {
+    kind = NK_ClassDecl;
 
 
     extends = ex;
@@ -137,6 +150,13 @@ ClassDecl::ClassDecl(Identifier *n, NamedType *ex, List<NamedType *> *imp, List<
     (members = m)->SetParentAll(this);
     instance_size = 4;
     vtable_size = 0;
+    var_members = NULL;
+    methods = NULL;
+    scope = 0;
+    member_table = NULL;
+    subclasses = new List<ClassDecl *>;
+    hier_pre = hier_post = -1;
+    hier_ifaces = new BitSet;
 }
 
 void ClassDecl::BuildSymTable() {
@@ -150,7 +170,7 @@ void ClassDecl::BuildSymTable() {
         id->SetDecl(this);
     }
 
-    scopeHandler->BuildScope(this->GetId()->GetIdName());
+    scope = scopeHandler->BuildScope(this->GetId()->GetIdName());
     if (extends) {
 
         scopeHandler->SetScopeParent(extends->GetId()->GetIdName());
@@ -173,7 +193,7 @@ void ClassDecl::CheckDecl() {
     for (int i = 0; i < implements->NumElements(); i++) {
         implements->Nth(i)->Check(sem_decl, interfaceReason);
     }
-    scopeHandler->EnterScope();
+    scopeHandler->EnterScope(scope);
     members->CheckAll(sem_decl);
     scopeHandler->ExitScope();
 
@@ -182,7 +202,7 @@ void ClassDecl::CheckDecl() {
 }
 
 void ClassDecl::CheckInherit() {
-    scopeHandler->EnterScope();
+    scopeHandler->EnterScope(scope);
 
     for (int i = 0; i < members->NumElements(); i++) {
         Decl *d = members->Nth(i);
@@ -213,8 +233,8 @@ void ClassDecl::CheckInherit() {
                     return;
                 } else {
 
-                    FunctionDecl *fn1 = dynamic_cast<FunctionDecl *>(d);
-                    FunctionDecl *fn2 = dynamic_cast<FunctionDecl *>(t);
+                    FunctionDecl *fn1 = cast<FunctionDecl>(d);
+                    FunctionDecl *fn2 = cast<FunctionDecl>(t);
                     if (fn1->GetType() && fn2->GetType()
                         && !fn1->IsEquivalentTo(fn2)) {
 
@@ -227,8 +247,8 @@ void ClassDecl::CheckInherit() {
             t = scopeHandler->LookupInterface(d->GetId());
             if (t != NULL) {
 
-                FunctionDecl *fn1 = dynamic_cast<FunctionDecl *>(d);
-                FunctionDecl *fn2 = dynamic_cast<FunctionDecl *>(t);
+                FunctionDecl *fn1 = cast<FunctionDecl>(d);
+                FunctionDecl *fn2 = cast<FunctionDecl>(t);
                 if (fn1->GetType() && fn2->GetType()
                     && !fn1->IsEquivalentTo(fn2)) {
 
@@ -245,7 +265,7 @@ void ClassDecl::CheckInherit() {
     for (int i = 0; i < implements->NumElements(); i++) {
         Decl *d = implements->Nth(i)->GetId()->GetDecl();
         if (d != NULL) {
-            List<Decl *> *m = dynamic_cast<InterfaceDecl *>(d)->GetMembers();
+            List<Decl *> *m = cast<InterfaceDecl>(d)->GetMembers();
 
             for (int j = 0; j < m->NumElements(); j++) {
                 Identifier *mid = m->Nth(j)->GetId();
@@ -256,8 +276,8 @@ void ClassDecl::CheckInherit() {
                     break;
                 } else {
 
-                    FunctionDecl *fn1 = dynamic_cast<FunctionDecl *>(m->Nth(j));
-                    FunctionDecl *fn2 = dynamic_cast<FunctionDecl *>(t);
+                    FunctionDecl *fn1 = dyn_cast<FunctionDecl>(m->Nth(j));
+                    FunctionDecl *fn2 = dyn_cast<FunctionDecl>(t);
                     if (!fn1 || !fn2 || !fn1->GetType() || !fn2->GetType()
                         || !fn1->IsEquivalentTo(fn2)) {
                         semantic_error = 1;
@@ -283,111 +303,111 @@ void ClassDecl::Check(checkStep c) {
             id->Check(c);
             if (extends) extends->Check(c);
             implements->CheckAll(c);
-            scopeHandler->EnterScope();
+            scopeHandler->EnterScope(scope);
             members->CheckAll(c);
             scopeHandler->ExitScope();
     }
 }
 
 bool ClassDecl::IsChildOf(Decl *other) {
-    if (other->IsClassDecl()) {
-        if (id->IsEquivalentTo(other->GetId())) {
-
-            return true;
-        } else if (!extends) {
-            return false;
-        } else {
-
-            Decl *d = extends->GetId()->GetDecl();
-            return dynamic_cast<ClassDecl *>(d)->IsChildOf(other);
-        }
+    if (other == this) {
+        return true;
+    } else if (other->IsClassDecl()) {
+        ClassDecl *c = cast<ClassDecl>(other);
+        return hier_pre >= 0 && c->hier_pre <= hier_pre && hier_post <= c->hier_post;
     } else if (other->IsInterfaceDecl()) {
-        for (int i = 0; i < implements->NumElements(); i++) {
-            Identifier *iid = implements->Nth(i)->GetId();
-            if (iid->IsEquivalentTo(other->GetId())) {
-                return true;
-            }
-        }
-        if (!extends) {
-            return false;
-        } else {
-
-            Decl *d = extends->GetId()->GetDecl();
-            return dynamic_cast<ClassDecl *>(d)->IsChildOf(other);
-        }
+        int i = cast<InterfaceDecl>(other)->GetHierarchyIndex();
+        return i >= 0 && hier_ifaces->Test(i);
     } else {
         return false;
     }
 }
 
-void ClassDecl::AddMembersToList(List<VariableDecl *> *vars, List<FunctionDecl *> *fns) {
-    for (int i = members->NumElements() - 1; i >= 0; i--) {
-        Decl *d = members->Nth(i);
-        if (d->IsVariableDecl()) {
-            vars->InsertAt(dynamic_cast<VariableDecl *>(d), 0);
-        } else if (d->IsFunctionDecl()) {
-            fns->InsertAt(dynamic_cast<FunctionDecl *>(d), 0);
+void ClassDecl::NumberHierarchy(int &counter, int numInterfaces) {
+    hier_pre = counter++;
+    hier_ifaces->Resize(numInterfaces);
+
+    ClassDecl *p = GetParentClass();
+    if (p) hier_ifaces->UnionWith(*p->hier_ifaces);
+    for (int i = 0; i < implements->NumElements(); i++) {
+        Decl *d = implements->Nth(i)->GetId()->GetDecl();
+        if (isa<InterfaceDecl>(d)) {
+            int idx = cast<InterfaceDecl>(d)->GetHierarchyIndex();
+            if (idx >= 0) hier_ifaces->Set(idx);
         }
     }
-}
-
-void ClassDecl::AssignOffset() {
 
-
-    var_members = new List<VariableDecl *>;
-    methods = new List<FunctionDecl *>;
-    ClassDecl *c = this;
-    while (c) {
-        c->AddMembersToList(var_members, methods);
-        NamedType *t = c->GetExtends();
-        if (!t) break;
-        c = dynamic_cast<ClassDecl *>(t->GetId()->GetDecl());
+    for (int i = 0; i < subclasses->NumElements(); i++) {
+        subclasses->Nth(i)->NumberHierarchy(counter, numInterfaces);
     }
+    hier_post = counter++;
+}
 
+ClassDecl *ClassDecl::GetParentClass() {
+    if (!extends) return NULL;
+    return dyn_cast<ClassDecl>(extends->GetId()->GetDecl());
+}
 
-    for (int i = 0; i < methods->NumElements(); i++) {
-        FunctionDecl *f1 = methods->Nth(i);
-        for (int j = i + 1; j < methods->NumElements(); j++) {
-            FunctionDecl *f2 = methods->Nth(j);
-            if (!strcmp(f1->GetId()->GetIdName(), f2->GetId()->GetIdName())) {
-
+void ClassDecl::BuildMemberTable() {
+    if (member_table) return;
+    member_table = new Hashtable<Decl *>;
 
-                methods->RemoveAt(i);
-                methods->InsertAt(f2, i);
-                methods->RemoveAt(j);
-                j--;
-            }
+    ClassDecl *p = GetParentClass();
+    if (p) {
+        p->BuildMemberTable();
+        Iterator<Decl *> it = p->GetMemberTable()->GetIterator();
+        Decl *d;
+        while ((d = it.GetNextValue()) != NULL) {
+            member_table->Enter(d->GetId()->GetIdName(), d);
         }
     }
 
+    for (int i = 0; i < members->NumElements(); i++) {
+        Decl *d = members->Nth(i);
+        member_table->Enter(d->GetId()->GetIdName(), d);
+    }
+    scopeHandler->SetMemberTable(scope, member_table);
+}
 
-    for (int i = 0; i < methods->NumElements(); i++) {
+void ClassDecl::AssignOffset() {
+    if (methods) return;
 
-    }
 
-    for (int i = 0; i < var_members->NumElements(); i++) {
+    var_members = new List<VariableDecl *>;
+    methods = new List<FunctionDecl *>;
 
+    ClassDecl *p = GetParentClass();
+    if (p) p->AssignOffset();
+    if (p && p->methods) {
+        for (int i = 0; i < p->var_members->NumElements(); i++) {
+            var_members->Append(p->var_members->Nth(i));
+        }
+        for (int i = 0; i < p->methods->NumElements(); i++) {
+            FunctionDecl *f = p->methods->Nth(i);
+            Decl *o = member_table->Lookup(f->GetId()->GetIdName());
+            methods->Append(isa<FunctionDecl>(o) ? cast<FunctionDecl>(o) : f);
+        }
     }
 
 
-    instance_size = var_members->NumElements() * 4 + 4;
-    vtable_size = methods->NumElements() * 4;
-
-    int var_offset = instance_size;
-    for (int i = members->NumElements() - 1; i >= 0; i--) {
+    for (int i = 0; i < members->NumElements(); i++) {
         Decl *d = members->Nth(i);
         if (d->IsVariableDecl()) {
-            var_offset -= 4;
-            d->AssignMemberOffset(true, var_offset);
+            var_members->Append(cast<VariableDecl>(d));
+            d->AssignMemberOffset(true, var_members->NumElements() * 4);
         } else if (d->IsFunctionDecl()) {
-
-            for (int i = 0; i < methods->NumElements(); i++) {
-                FunctionDecl *f1 = methods->Nth(i);
-                if (!strcmp(f1->GetId()->GetIdName(), d->GetId()->GetIdName()))
-                    d->AssignMemberOffset(true, i * 4);
+            Decl *t = p ? p->GetMemberTable()->Lookup(d->GetId()->GetIdName()) : NULL;
+            if (isa<FunctionDecl>(t)) {
+                d->AssignMemberOffset(true, cast<FunctionDecl>(t)->GetVTableOffset());
+            } else {
+                d->AssignMemberOffset(true, methods->NumElements() * 4);
+                methods->Append(cast<FunctionDecl>(d));
             }
         }
     }
+
+    instance_size = var_members->NumElements() * 4 + 4;
+    vtable_size = methods->NumElements() * 4;
 }
 
 void ClassDecl::AddPrefixToMethods() {
@@ -413,8 +433,11 @@ void ClassDecl::Emit() {
 }
 
 InterfaceDecl::InterfaceDecl(Identifier *n, List<Decl *> *m) : Decl(n) {
+    kind = NK_InterfaceDecl;
 
     (members = m)->SetParentAll(this);
+    scope = 0;
+    hier_idx = -1;
 }
 
 void InterfaceDecl::BuildSymTable() {
@@ -426,7 +449,7 @@ void InterfaceDecl::BuildSymTable() {
         idx = scopeHandler->InsertSymbol(this);
         id->SetDecl(this);
     }
-    scopeHandler->BuildScope(this->GetId()->GetIdName());
+    scope = scopeHandler->BuildScope(this->GetId()->GetIdName());
     members->BuildSymTableAll();
     scopeHandler->ExitScope();
 }
@@ -439,7 +462,7 @@ void InterfaceDecl::Check(checkStep c) {
 
         default:
             id->Check(c);
-            scopeHandler->EnterScope();
+            scopeHandler->EnterScope(scope);
             members->CheckAll(c);
             scopeHandler->ExitScope();
     }
@@ -452,11 +475,14 @@ void InterfaceDecl::Emit() {
 }
 
 FunctionDecl::FunctionDecl(Identifier *n, Type *r, List<VariableDecl *> *d) : Decl(n) {
+    kind = NK_FunctionDecl;
 
     (returnType = r)->SetParent(this);
     (formals = d)->SetParentAll(this);
     body = NULL;
     vtable_ofst = -1;
+    scope = 0;
+    enclosing_class = NULL;
 }
 
 void FunctionDecl::SetFunctionBody(Stmt *b) {
@@ -464,6 +490,8 @@ void FunctionDecl::SetFunctionBody(Stmt *b) {
 }
 
 void FunctionDecl::BuildSymTable() {
+    enclosing_class = dyn_cast<ClassDecl>(parent);
+
     if (scopeHandler->LocalLookup(this->GetId())) {
         Decl *d = scopeHandler->Lookup(this->GetId());
         semantic_error = 1;
@@ -472,7 +500,7 @@ void FunctionDecl::BuildSymTable() {
         idx = scopeHandler->InsertSymbol(this);
         id->SetDecl(this);
     }
-    scopeHandler->BuildScope();
+    scope = scopeHandler->BuildScope();
     formals->BuildSymTableAll();
     if (body) body->BuildSymTable();
     scopeHandler->ExitScope();
@@ -481,7 +509,7 @@ void FunctionDecl::BuildSymTable() {
 void FunctionDecl::CheckDecl() {
     returnType->Check(sem_decl);
     id->Check(sem_decl);
-    scopeHandler->EnterScope();
+    scopeHandler->EnterScope(scope);
     formals->CheckAll(sem_decl);
     if (body) body->Check(sem_decl);
     scopeHandler->ExitScope();
@@ -505,7 +533,7 @@ void FunctionDecl::Check(checkStep c) {
         default:
             returnType->Check(c);
             id->Check(c);
-            scopeHandler->EnterScope();
+            scopeHandler->EnterScope(scope);
             formals->CheckAll(c);
             if (body) body->Check(c);
             scopeHandler->ExitScope();
@@ -518,7 +546,7 @@ bool FunctionDecl::IsEquivalentTo(Decl *other) {
     if (!other->IsFunctionDecl()) {
         return false;
     }
-    FunctionDecl *fn = dynamic_cast<FunctionDecl *>(other);
+    FunctionDecl *fn = dyn_cast<FunctionDecl>(other);
     if (!returnType->IsEquivalentTo(fn->GetType())) {
         return false;
     }
@@ -528,9 +556,9 @@ bool FunctionDecl::IsEquivalentTo(Decl *other) {
     for (int i = 0; i < formals->NumElements(); i++) {
 
         Type *var_type1 =
-                (dynamic_cast<VariableDecl *>(formals->Nth(i)))->GetType();
+                formals->Nth(i)->GetType();
         Type *var_type2 =
-                (dynamic_cast<VariableDecl *>(fn->GetFormals()->Nth(i)))->GetType();
+                fn->GetFormals()->Nth(i)->GetType();
         if (!var_type1->IsEquivalentTo(var_type2)) {
             return false;
         }
@@ -541,10 +569,9 @@ bool FunctionDecl::IsEquivalentTo(Decl *other) {
 void FunctionDecl::AddPrefixToMethods() {
 
 
-    Decl *d = dynamic_cast<Decl *>(this->GetParent());
-    if (d && d->IsClassDecl()) {
+    if (enclosing_class) {
         id->AddPrefix(".");
-        id->AddPrefix(d->GetId()->GetIdName());
+        id->AddPrefix(enclosing_class->GetId()->GetIdName());
         id->AddPrefix("_");
     } else if (strcmp(id->GetIdName(), "main")) {
         id->AddPrefix("_");
@@ -563,14 +590,13 @@ void FunctionDecl::Emit() {
 
     }
 
-    Decl *d = dynamic_cast<Decl *>(this->GetParent());
     CG->GenLabel(id->GetIdName());
 
 
-    BeginFunc *f = CG->GenBeginFunc();
+    CG->GenBeginFunc();
 
 
-    if (d && d->IsClassDecl()) {
+    if (enclosing_class) {
         CG->GetNextParamLoc();
     }
 
@@ -589,9 +615,6 @@ void FunctionDecl::Emit() {
 
     if (body) body->Emit();
 
-
-    f->SetFrameSize(CG->GetFrameSize());
-
     CG->GenEndFunc();
 }
 
@@ -603,6 +626,7 @@ void EmptyExpr::Check(checkStep c) {
 }
 
 IntLiteral::IntLiteral(yyltype loc, int val) : Expr(loc) {
+    kind = NK_IntLiteral;
     value = val;
 }
 
@@ -617,6 +641,7 @@ void IntLiteral::Emit() {
 }
 
 DoubleLiteral::DoubleLiteral(yyltype loc, double val) : Expr(loc) {
+    kind = NK_DoubleLiteral;
     value = val;
 }
 
@@ -633,6 +658,7 @@ void DoubleLiteral::Emit() {
 }
 
 BoolLiteral::BoolLiteral(yyltype loc, bool val) : Expr(loc) {
+    kind = NK_BoolLiteral;
     value = val;
 }
 
@@ -647,8 +673,9 @@ void BoolLiteral::Emit() {
 }
 
 StringLiteral::StringLiteral(yyltype loc, const char *val) : Expr(loc) {
+    kind = NK_StringLiteral;
 
-    value = strdup(val);
+    value = val;
 }
 
 void StringLiteral::Check(checkStep c) {
@@ -673,6 +700,7 @@ void NullLiteral::Emit() {
 }
 
 Operator::Operator(yyltype loc, const char *tok) : Node(loc) {
+    kind = NK_Operator;
 
     strncpy(tokenString, tok, sizeof(tokenString));
 }
@@ -975,6 +1003,7 @@ void This::Emit() {
 }
 
 ArrayAccess::ArrayAccess(yyltype loc, Expr *b, Expr *s) : LValue(loc) {
+    kind = NK_ArrayAccess;
     (base = b)->SetParent(this);
     (subscript = s)->SetParent(this);
 }
@@ -1005,7 +1034,7 @@ void ArrayAccess::CheckType() {
 
     if (!err) {
 
-        semantic_type = (dynamic_cast<ArrayType *>(t))->GetElemType();
+        semantic_type = cast<ArrayType>(t)->GetElemType();
     }
 }
 
@@ -1050,6 +1079,7 @@ Location *ArrayAccess::GetEmitLocDeref() {
 
 FieldAccess::FieldAccess(Expr *b, Identifier *f)
         : LValue(b ? Join(b->GetLocation(), f->GetLocation()) : *f->GetLocation()) {
+    kind = NK_FieldAccess;
 
     base = b;
     if (base) base->SetParent(this);
@@ -1058,7 +1088,8 @@ FieldAccess::FieldAccess(Expr *b, Identifier *f)
 
 void FieldAccess::CheckDecl() {
     if (!base) {
-        Decl *d = scopeHandler->Lookup(field);
+        Decl *d = field->GetDecl();
+        if (!d) d = scopeHandler->Lookup(field);
         if (d == NULL) {
             semantic_error = 1;
             return;
@@ -1095,8 +1126,13 @@ void FieldAccess::CheckType() {
             return;
         }
 
-        Decl *d = scopeHandler->LookupField(
-                dynamic_cast<NamedType *>(base_t)->GetId(), field);
+        if (field->GetDecl()) {
+            semantic_type = field->GetDecl()->GetType();
+            return;
+        }
+
+        Identifier *base_id = cast<NamedType>(base_t)->GetId();
+        Decl *d = scopeHandler->LookupField(base_id, field);
 
         if (d == NULL || !d->IsVariableDecl()) {
             semantic_error = 1;
@@ -1115,8 +1151,9 @@ void FieldAccess::CheckType() {
 
 
             Type *cur_t = cur_class->GetType();
-            d = scopeHandler->LookupField(
-                    dynamic_cast<NamedType *>(cur_t)->GetId(), field);
+            Identifier *cur_id = cast<NamedType>(cur_t)->GetId();
+            if (!cur_id->IsEquivalentTo(base_id))
+                d = scopeHandler->LookupField(cur_id, field);
 
             if (d == NULL || !d->IsVariableDecl()) {
                 semantic_error = 1;
@@ -1169,6 +1206,7 @@ Location *FieldAccess::GetEmitLocDeref() {
 }
 
 Call::Call(yyltype loc, Expr *b, Identifier *f, List<Expr *> *a) : Expr(loc) {
+    kind = NK_Call;
 
     base = b;
     if (base) base->SetParent(this);
@@ -1178,7 +1216,8 @@ Call::Call(yyltype loc, Expr *b, Identifier *f, List<Expr *> *a) : Expr(loc) {
 
 void Call::CheckDecl() {
     if (!base) {
-        Decl *d = scopeHandler->Lookup(field);
+        Decl *d = field->GetDecl();
+        if (!d) d = scopeHandler->Lookup(field);
         if (d == NULL || !d->IsFunctionDecl()) {
             semantic_error = 1;
             return;
@@ -1219,8 +1258,9 @@ void Call::CheckType() {
                 semantic_error = 1;
                 return;
             } else {
-                Decl *d = scopeHandler->LookupField(
-                        dynamic_cast<NamedType *>(t)->GetId(), field);
+                Decl *d = field->GetDecl();
+                if (!d) d = scopeHandler->LookupField(
+                            cast<NamedType>(t)->GetId(), field);
                 if (d == NULL || !d->IsFunctionDecl()) {
                     semantic_error = 1;
                     return;
@@ -1238,7 +1278,7 @@ void Call::CheckType() {
 void Call::CheckFuncArgs() {
     Decl *f = field->GetDecl();
     if (!f || !f->IsFunctionDecl()) return;
-    FunctionDecl *fun = dynamic_cast<FunctionDecl *>(f);
+    FunctionDecl *fun = cast<FunctionDecl>(f);
     List<VariableDecl *> *formals = fun->GetFormals();
 
     int n_expected = formals->NumElements();
@@ -1288,7 +1328,7 @@ void Call::Emit() {
         return;
     }
 
-    FunctionDecl *fn = dynamic_cast<FunctionDecl *>(field->GetDecl());
+    FunctionDecl *fn = cast<FunctionDecl>(field->GetDecl());
 
     bool is_ACall = (base != NULL) || (fn->IsClassMember());
 
@@ -1331,6 +1371,7 @@ void Call::Emit() {
 }
 
 NewExpr::NewExpr(yyltype loc, NamedType *c) : Expr(loc) {
+    kind = NK_NewExpr;
 
     (cType = c)->SetParent(this);
 }
@@ -1361,7 +1402,7 @@ void NewExpr::Check(checkStep c) {
 }
 
 void NewExpr::Emit() {
-    ClassDecl *d = dynamic_cast<ClassDecl *>(cType->GetId()->GetDecl());
+    ClassDecl *d = cast<ClassDecl>(cType->GetId()->GetDecl());
 
     int size = d->GetInstanceSize();
     Location *t = CG->GenLoadConstant(size);
@@ -1371,6 +1412,7 @@ void NewExpr::Emit() {
 }
 
 NewArrayExpr::NewArrayExpr(yyltype loc, Expr *sz, Type *et) : Expr(loc) {
+    kind = NK_NewArrayExpr;
 
     (size = sz)->SetParent(this);
     (elemType = et)->SetParent(this);
@@ -1453,6 +1495,7 @@ void ReadLineExpr::Emit() {
 
 PostfixExpr::PostfixExpr(LValue *lv, Operator *o)
         : Expr(Join(lv->GetLocation(), o->GetLocation())) {
+    kind = NK_PostfixExpr;
 
     (lvalue = lv)->SetParent(this);
     (op = o)->SetParent(this);
@@ -1510,6 +1553,7 @@ void PostfixExpr::Emit() {
 
 
 Program::Program(List<Decl *> *d) {
+    kind = NK_Program;
 
     (decls = d)->SetParentAll(this);
 }
@@ -1519,6 +1563,7 @@ void Program::BuildSymTable() {
 
 
     decls->BuildSymTableAll();
+    scopeHandler->LinkScopes();
 }
 
 void Program::Check() {
@@ -1527,15 +1572,43 @@ void Program::Check() {
     scopeHandler->ResetSymbolTable();
     decls->CheckAll(sem_decl);
 
+    for (int i = 0; i < decls->NumElements(); i++) {
+        decls->Nth(i)->BuildMemberTable();
+    }
+
 
     scopeHandler->ResetSymbolTable();
     decls->CheckAll(sem_inh);
 
+    NumberHierarchy();
+
 
     scopeHandler->ResetSymbolTable();
     decls->CheckAll(sem_type);
 }
 
+void Program::NumberHierarchy() {
+    int numInterfaces = 0;
+    for (int i = 0; i < decls->NumElements(); i++) {
+        Decl *d = decls->Nth(i);
+        if (isa<InterfaceDecl>(d)) {
+            cast<InterfaceDecl>(d)->SetHierarchyIndex(numInterfaces++);
+        } else if (isa<ClassDecl>(d)) {
+            ClassDecl *p = cast<ClassDecl>(d)->GetParentClass();
+            if (p) p->AddSubclass(cast<ClassDecl>(d));
+        }
+    }
+
+
+    int counter = 0;
+    for (int i = 0; i < decls->NumElements(); i++) {
+        Decl *d = decls->Nth(i);
+        if (isa<ClassDecl>(d) && !cast<ClassDecl>(d)->GetParentClass()) {
+            cast<ClassDecl>(d)->NumberHierarchy(counter, numInterfaces);
+        }
+    }
+}
+
 void Program::Emit() {
 
 
@@ -1572,25 +1645,28 @@ void Program::Emit() {
         return;
 
 
+    passManager.Run(CG);
     CG->DoFinalCodeGen();
 }
 
 StmtBlock::StmtBlock(List<VariableDecl *> *d, List<Stmt *> *s) {
+    kind = NK_StmtBlock;
 
     (decls = d)->SetParentAll(this);
     (stmts = s)->SetParentAll(this);
+    scope = 0;
 }
 
 
 void StmtBlock::BuildSymTable() {
-    scopeHandler->BuildScope();
+    scope = scopeHandler->BuildScope();
     decls->BuildSymTableAll();
     stmts->BuildSymTableAll();
     scopeHandler->ExitScope();
 }
 
 void StmtBlock::Check(checkStep c) {
-    scopeHandler->EnterScope();
+    scopeHandler->EnterScope(scope);
     decls->CheckAll(c);
     stmts->CheckAll(c);
     scopeHandler->ExitScope();
@@ -1605,9 +1681,11 @@ ConditionalStmt::ConditionalStmt(Expr *t, Stmt *b) {
 
     (test = t)->SetParent(this);
     (body = b)->SetParent(this);
+    scope = 0;
 }
 
 ForStmt::ForStmt(Expr *i, Expr *t, Expr *s, Stmt *b) : LoopStmt(t, b) {
+    kind = NK_ForStmt;
 
     (init = i)->SetParent(this);
     (step = s)->SetParent(this);
@@ -1615,7 +1693,7 @@ ForStmt::ForStmt(Expr *i, Expr *t, Expr *s, Stmt *b) : LoopStmt(t, b) {
 
 
 void ForStmt::BuildSymTable() {
-    scopeHandler->BuildScope();
+    scope = scopeHandler->BuildScope();
     body->BuildSymTable();
     scopeHandler->ExitScope();
 }
@@ -1628,7 +1706,7 @@ void ForStmt::CheckType() {
         return;
     }
     step->Check(sem_type);
-    scopeHandler->EnterScope();
+    scopeHandler->EnterScope(scope);
     body->Check(sem_type);
     scopeHandler->ExitScope();
 }
@@ -1642,7 +1720,7 @@ void ForStmt::Check(checkStep c) {
             init->Check(c);
             test->Check(c);
             step->Check(c);
-            scopeHandler->EnterScope();
+            scopeHandler->EnterScope(scope);
             body->Check(c);
             scopeHandler->ExitScope();
     }
@@ -1668,7 +1746,7 @@ void ForStmt::Emit() {
 
 
 void WhileStmt::BuildSymTable() {
-    scopeHandler->BuildScope();
+    scope = scopeHandler->BuildScope();
     body->BuildSymTable();
     scopeHandler->ExitScope();
 }
@@ -1679,7 +1757,7 @@ void WhileStmt::CheckType() {
         semantic_error = 1;
         return;
     }
-    scopeHandler->EnterScope();
+    scopeHandler->EnterScope(scope);
     body->Check(sem_type);
     scopeHandler->ExitScope();
 }
@@ -1691,7 +1769,7 @@ void WhileStmt::Check(checkStep c) {
             break;
         default:
             test->Check(c);
-            scopeHandler->EnterScope();
+            scopeHandler->EnterScope(scope);
             body->Check(c);
             scopeHandler->ExitScope();
     }
@@ -1714,18 +1792,20 @@ void WhileStmt::Emit() {
 }
 
 IfStmt::IfStmt(Expr *t, Stmt *tb, Stmt *eb) : ConditionalStmt(t, tb) {
+    kind = NK_IfStmt;
 
     elseBody = eb;
     if (elseBody) elseBody->SetParent(this);
+    else_scope = 0;
 }
 
 
 void IfStmt::BuildSymTable() {
-    scopeHandler->BuildScope();
+    scope = scopeHandler->BuildScope();
     body->BuildSymTable();
     scopeHandler->ExitScope();
     if (elseBody) {
-        scopeHandler->BuildScope();
+        else_scope = scopeHandler->BuildScope();
         elseBody->BuildSymTable();
         scopeHandler->ExitScope();
     }
@@ -1737,11 +1817,11 @@ void IfStmt::CheckType() {
         semantic_error = 1;
         return;
     }
-    scopeHandler->EnterScope();
+    scopeHandler->EnterScope(scope);
     body->Check(sem_type);
     scopeHandler->ExitScope();
     if (elseBody) {
-        scopeHandler->EnterScope();
+        scopeHandler->EnterScope(else_scope);
         elseBody->Check(sem_type);
         scopeHandler->ExitScope();
     }
@@ -1754,11 +1834,11 @@ void IfStmt::Check(checkStep c) {
             break;
         default:
             test->Check(c);
-            scopeHandler->EnterScope();
+            scopeHandler->EnterScope(scope);
             body->Check(c);
             scopeHandler->ExitScope();
             if (elseBody) {
-                scopeHandler->EnterScope();
+                scopeHandler->EnterScope(else_scope);
                 elseBody->Check(c);
                 scopeHandler->ExitScope();
             }
@@ -1780,13 +1860,16 @@ void IfStmt::Emit() {
     CG->GenLabel(l1);
 }
 
+void BreakStmt::BuildSymTable() {
+    Node *n = parent;
+    while (n && !isa<LoopStmt>(n) && !isa<SwitchStmt>(n)) {
+        n = n->GetParent();
+    }
+    enclosing = cast<Stmt>(n);
+}
+
 void BreakStmt::Check(checkStep c) {
-    if (c == sem_type) {
-        Node *n = this;
-        while (n->GetParent()) {
-            if (n->IsLoopStmt() || n->IsCaseStmt()) return;
-            n = n->GetParent();
-        }
+    if (c == sem_type && !enclosing) {
         semantic_error = 1;
         return;
     }
@@ -1794,41 +1877,33 @@ void BreakStmt::Check(checkStep c) {
 
 void BreakStmt::Emit() {
 
-    Node *n = this;
-    while (n->GetParent()) {
-        if (n->IsLoopStmt()) {
-            const char *l = dynamic_cast<LoopStmt *>(n)->GetEndLoopLabel();
-
-            CG->GenGoto(l);
-            return;
-        } else if (n->IsSwitchStmt()) {
-            const char *l = dynamic_cast<SwitchStmt *>(n)->GetEndSwitchLabel();
-
-            CG->GenGoto(l);
-            return;
-        }
-        n = n->GetParent();
+    if (isa<LoopStmt>(enclosing)) {
+        CG->GenGoto(cast<LoopStmt>(enclosing)->GetEndLoopLabel());
+    } else if (isa<SwitchStmt>(enclosing)) {
+        CG->GenGoto(cast<SwitchStmt>(enclosing)->GetEndSwitchLabel());
     }
 }
 
 CaseStmt::CaseStmt(IntLiteral *v, List<Stmt *> *s) {
+    kind = NK_CaseStmt;
 
     value = v;
     if (value) value->SetParent(this);
     (stmts = s)->SetParentAll(this);
     case_label = NULL;
+    scope = 0;
 }
 
 
 void CaseStmt::BuildSymTable() {
-    scopeHandler->BuildScope();
+    scope = scopeHandler->BuildScope();
     stmts->BuildSymTableAll();
     scopeHandler->ExitScope();
 }
 
 void CaseStmt::Check(checkStep c) {
     if (value) value->Check(c);
-    scopeHandler->EnterScope();
+    scopeHandler->EnterScope(scope);
     stmts->CheckAll(c);
     scopeHandler->ExitScope();
 }
@@ -1843,22 +1918,24 @@ void CaseStmt::Emit() {
 }
 
 SwitchStmt::SwitchStmt(Expr *e, List<CaseStmt *> *c) {
+    kind = NK_SwitchStmt;
 
     (expr = e)->SetParent(this);
     (cases = c)->SetParentAll(this);
     end_switch_label = NULL;
+    scope = 0;
 }
 
 
 void SwitchStmt::BuildSymTable() {
-    scopeHandler->BuildScope();
+    scope = scopeHandler->BuildScope();
     cases->BuildSymTableAll();
     scopeHandler->ExitScope();
 }
 
 void SwitchStmt::Check(checkStep c) {
     expr->Check(c);
-    scopeHandler->EnterScope();
+    scopeHandler->EnterScope(scope);
     cases->CheckAll(c);
     scopeHandler->ExitScope();
 }
@@ -1903,22 +1980,26 @@ void SwitchStmt::Emit() {
 }
 
 ReturnStmt::ReturnStmt(yyltype loc, Expr *e) : Stmt(loc) {
+    kind = NK_ReturnStmt;
 
     (expr = e)->SetParent(this);
+    enclosing = NULL;
 }
 
 
+void ReturnStmt::BuildSymTable() {
+    Node *n = parent;
+    while (n && !isa<FunctionDecl>(n)) {
+        n = n->GetParent();
+    }
+    enclosing = cast<FunctionDecl>(n);
+}
+
 void ReturnStmt::Check(checkStep c) {
     expr->Check(c);
     if (c == sem_type) {
-        Node *n = this;
-
-        while (n->GetParent()) {
-            if (dynamic_cast<FunctionDecl *>(n) != NULL) break;
-            n = n->GetParent();
-        }
         Type *t_given = expr->GetType();
-        Type *t_expected = dynamic_cast<FunctionDecl *>(n)->GetType();
+        Type *t_expected = enclosing->GetType();
         if (t_given && t_expected) {
             if (!t_expected->IsCompatibleWith(t_given)) {
                 semantic_error = 1;
@@ -1938,6 +2019,7 @@ void ReturnStmt::Emit() {
 }
 
 PrintStmt::PrintStmt(List<Expr *> *a) {
+    kind = NK_PrintStmt;
 
     (args = a)->SetParentAll(this);
 }
@@ -1992,6 +2074,7 @@ Type *Type::stringType = new Type("string");
 Type *Type::errorType = new Type("error");
 
 Type::Type(const char *n) {
+    kind = NK_Type;
 
     typeName = strdup(n);
     semantic_type = NULL;
@@ -2012,13 +2095,15 @@ void Type::Check(checkStep c) {
 }
 
 NamedType::NamedType(Identifier *i) : Type(*i->GetLocation()) {
+    kind = NK_NamedType;
 
     (id = i)->SetParent(this);
 }
 
 
 void NamedType::CheckDecl(checkFor r) {
-    Decl *d = scopeHandler->Lookup(this->id);
+    Decl *d = id->GetDecl();
+    if (!d) d = scopeHandler->Lookup(this->id);
     if (d == NULL || (!d->IsClassDecl() && !d->IsInterfaceDecl())) {
         semantic_error = 1;
         return;
@@ -2048,7 +2133,7 @@ bool NamedType::IsEquivalentTo(Type *other) {
     if (!other->IsNamedType()) {
         return false;
     }
-    NamedType *nt = dynamic_cast<NamedType *>(other);
+    NamedType *nt = cast<NamedType>(other);
     return (id->IsEquivalentTo(nt->GetId()));
 }
 
@@ -2063,20 +2148,21 @@ bool NamedType::IsCompatibleWith(Type *other) {
     } else if (this->IsEquivalentTo(other)) {
         return true;
     } else {
-        NamedType *nt = dynamic_cast<NamedType *>(other);
+        NamedType *nt = cast<NamedType>(other);
         Decl *decl1 = id->GetDecl();
         Decl *decl2 = nt->GetId()->GetDecl();
 
         if (!decl2->IsClassDecl()) {
             return false;
         }
-        ClassDecl *cdecl2 = dynamic_cast<ClassDecl *>(decl2);
+        ClassDecl *cdecl2 = cast<ClassDecl>(decl2);
 
         return cdecl2->IsChildOf(decl1);
     }
 }
 
 ArrayType::ArrayType(yyltype loc, Type *et) : Type(loc) {
+    kind = NK_ArrayType;
 
     (elemType = et)->SetParent(this);
 }
@@ -2103,7 +2189,7 @@ bool ArrayType::IsEquivalentTo(Type *other) {
     if (!other->IsArrayType()) {
         return false;
     }
-    ArrayType *nt = dynamic_cast<ArrayType *>(other);
+    ArrayType *nt = cast<ArrayType>(other);
     return (elemType->IsEquivalentTo(nt->GetElemType()));
 }
 
@@ -14,8 +14,24 @@
 
 extern CodeGenerator *CG;
 
+typedef enum {
+    NK_Node, NK_Identifier, NK_Error, NK_Operator, NK_Program,
+    NK_Type, NK_NamedType, NK_ArrayType,
+    NK_VariableDecl, NK_ClassDecl, NK_InterfaceDecl, NK_FunctionDecl,
+    NK_StmtBlock, NK_IfStmt, NK_ForStmt, NK_WhileStmt, NK_BreakStmt,
+    NK_CaseStmt, NK_SwitchStmt, NK_ReturnStmt, NK_PrintStmt,
+    NK_EmptyExpr, NK_IntLiteral, NK_DoubleLiteral, NK_BoolLiteral,
+    NK_StringLiteral, NK_NullLiteral,
+    NK_ArithmeticExpr, NK_RelationalExpr, NK_EqualityExpr, NK_LogicalExpr,
+    NK_AssignExpr,
+    NK_ArrayAccess, NK_FieldAccess,
+    NK_This, NK_Call, NK_NewExpr, NK_NewArrayExpr, NK_ReadIntegerExpr,
+    NK_ReadLineExpr, NK_PostfixExpr
+} nodeKind;
+
 class Node {
 protected:
+    nodeKind kind;
     yyltype *location;
     Node *parent;
     Type *semantic_type;
@@ -26,8 +42,14 @@ public:
 
     Node();
 
+    static void *operator new(size_t size) { return nodeArena.Alloc(size); }
+
+    static void operator delete(void *p) {}
+
     yyltype *GetLocation() { return location; }
 
+    nodeKind GetKind() const { return kind; }
+
     void SetParent(Node *p) { parent = p; }
 
     Node *GetParent() { return parent; }
@@ -52,19 +74,29 @@ public:
 };
 
 
+template<class T>
+inline bool isa(const Node *n) { return n && T::classof(n); }
+
+template<class T>
+inline T *cast(Node *n) { return static_cast<T *>(n); }
+
+template<class T>
+inline T *dyn_cast(Node *n) { return isa<T>(n) ? static_cast<T *>(n) : NULL; }
+
+
 class Identifier : public Node {
 protected:
-    char *name;
+    const char *name;
     Decl *decl;
 
     void CheckDecl();
 
 public:
-    Identifier(yyltype loc, const char *name);
+    Identifier(yyltype loc, const char *name); // name must be interned
 
     friend std::ostream &operator<<(std::ostream &out, Identifier *id) { return out << id->name; }
 
-    char *GetIdName() { return name; }
+    const char *GetIdName() { return name; }
 
     void Check(checkStep c);
 
@@ -85,7 +117,7 @@ public:
 
 class Error : public Node {
 public:
-    Error() : Node() {}
+    Error() : Node() { kind = NK_Error; }
 };
 
 
@@ -97,7 +129,10 @@ public :
     static Type *intType, *doubleType, *boolType, *voidType,
             *nullType, *stringType, *errorType;
 
-    Type(yyltype loc) : Node(loc) { semantic_type = NULL; }
+    Type(yyltype loc) : Node(loc) {
+        kind = NK_Type;
+        semantic_type = NULL;
+    }
 
     Type(const char *str);
 
@@ -140,6 +175,8 @@ protected:
 public:
     NamedType(Identifier *i);
 
+    static bool classof(const Node *n) { return n->GetKind() == NK_NamedType; }
+
 
     void PrintToStream(std::ostream &out) { out << id; }
 
@@ -165,6 +202,8 @@ protected:
 public:
     ArrayType(yyltype loc, Type *elemType);
 
+    static bool classof(const Node *n) { return n->GetKind() == NK_ArrayType; }
+
 
     void PrintToStream(std::ostream &out) { out << elemType << "[]"; }
 
@@ -198,6 +237,10 @@ protected:
 public:
     Decl(Identifier *name);
 
+    static bool classof(const Node *n) {
+        return n->GetKind() >= NK_VariableDecl && n->GetKind() <= NK_FunctionDecl;
+    }
+
     friend std::ostream &operator<<(std::ostream &out, Decl *d) { return out << d->id; }
 
     Identifier *GetId() { return id; }
@@ -213,6 +256,8 @@ public:
     virtual bool IsFunctionDecl() { return false; }
 
 
+    virtual void BuildMemberTable() {}
+
     virtual void AssignOffset() {}
 
     virtual void AssignMemberOffset(bool inClass, int offset) {}
@@ -230,14 +275,13 @@ protected:
 
     bool IsGlobal() { return this->GetParent()->GetParent() == NULL; }
 
-    bool IsClassMember() {
-        Decl *d = dynamic_cast<Decl *>(this->GetParent());
-        return d ? d->IsClassDecl() : false;
-    }
+    bool IsClassMember();
 
 public:
     VariableDecl(Identifier *name, Type *type);
 
+    static bool classof(const Node *n) { return n->GetKind() == NK_VariableDecl; }
+
     Type *GetType() { return type; }
 
     bool IsVariableDecl() { return true; }
@@ -265,6 +309,11 @@ protected:
     int vtable_size;
     List<VariableDecl *> *var_members;
     List<FunctionDecl *> *methods;
+    int scope;
+    Hashtable<Decl *> *member_table;
+    List<ClassDecl *> *subclasses;
+    int hier_pre, hier_post;
+    BitSet *hier_ifaces;
 
     void CheckDecl();
 
@@ -274,6 +323,8 @@ public:
     ClassDecl(Identifier *name, NamedType *extends,
               List<NamedType *> *implements, List<Decl *> *members);
 
+    static bool classof(const Node *n) { return n->GetKind() == NK_ClassDecl; }
+
     bool IsClassDecl() { return true; }
 
     void BuildSymTable();
@@ -282,8 +333,18 @@ public:
 
     bool IsChildOf(Decl *other);
 
+    void AddSubclass(ClassDecl *c) { subclasses->Append(c); }
+
+    void NumberHierarchy(int &counter, int numInterfaces);
+
     NamedType *GetExtends() { return extends; }
 
+    ClassDecl *GetParentClass();
+
+    void BuildMemberTable();
+
+    Hashtable<Decl *> *GetMemberTable() { return member_table; }
+
 
     void AssignOffset();
 
@@ -293,20 +354,24 @@ public:
 
     int GetVTableSize() { return vtable_size; }
 
-    void AddMembersToList(List<VariableDecl *> *vars, List<FunctionDecl *> *fns);
-
     void AddPrefixToMethods();
+
+    int GetScope() { return scope; }
 };
 
 class InterfaceDecl : public Decl {
 protected:
     List<Decl *> *members;
+    int scope;
+    int hier_idx;
 
     void CheckDecl();
 
 public:
     InterfaceDecl(Identifier *name, List<Decl *> *members);
 
+    static bool classof(const Node *n) { return n->GetKind() == NK_InterfaceDecl; }
+
     bool IsInterfaceDecl() { return true; }
 
     void BuildSymTable();
@@ -315,6 +380,12 @@ public:
 
     List<Decl *> *GetMembers() { return members; }
 
+    int GetScope() { return scope; }
+
+    void SetHierarchyIndex(int i) { hier_idx = i; }
+
+    int GetHierarchyIndex() { return hier_idx; }
+
 
     void Emit();
 };
@@ -325,12 +396,16 @@ protected:
     Type *returnType;
     Stmt *body;
     int vtable_ofst;
+    int scope;
+    ClassDecl *enclosing_class;
 
     void CheckDecl();
 
 public:
     FunctionDecl(Identifier *name, Type *returnType, List<VariableDecl *> *formals);
 
+    static bool classof(const Node *n) { return n->GetKind() == NK_FunctionDecl; }
+
     void SetFunctionBody(Stmt *b);
 
     Type *GetReturnType() { return returnType; }
@@ -354,12 +429,13 @@ public:
 
     int GetVTableOffset() { return vtable_ofst; }
 
+    ClassDecl *GetEnclosingClass() { return enclosing_class; }
+
+    int GetScope() { return scope; }
+
     bool HasReturnValue() { return returnType != Type::voidType; }
 
-    bool IsClassMember() {
-        Decl *d = dynamic_cast<Decl *>(this->GetParent());
-        return d ? d->IsClassDecl() : false;
-    }
+    bool IsClassMember() { return enclosing_class != NULL; }
 };
 
 
@@ -373,6 +449,8 @@ class Program : public Node {
 protected:
     List<Decl *> *decls;
 
+    void NumberHierarchy();
+
 public:
     Program(List<Decl *> *declList);
 
@@ -397,6 +475,7 @@ class StmtBlock : public Stmt {
 protected:
     List<VariableDecl *> *decls;
     List<Stmt *> *stmts;
+    int scope;
 
 public:
     StmtBlock(List<VariableDecl *> *variableDeclarations, List<Stmt *> *statements);
@@ -414,6 +493,7 @@ class ConditionalStmt : public Stmt {
 protected:
     Expr *test;
     Stmt *body;
+    int scope;
 
 public:
     ConditionalStmt(Expr *testExpr, Stmt *body);
@@ -427,6 +507,10 @@ public:
     LoopStmt(Expr *testExpr, Stmt *body)
             : ConditionalStmt(testExpr, body) {}
 
+    static bool classof(const Node *n) {
+        return n->GetKind() == NK_ForStmt || n->GetKind() == NK_WhileStmt;
+    }
+
     bool IsLoopStmt() { return true; }
 
 
@@ -456,7 +540,7 @@ protected:
     void CheckType();
 
 public:
-    WhileStmt(Expr *test, Stmt *body) : LoopStmt(test, body) {}
+    WhileStmt(Expr *test, Stmt *body) : LoopStmt(test, body) { kind = NK_WhileStmt; }
 
 
     void BuildSymTable();
@@ -470,6 +554,7 @@ public:
 class IfStmt : public ConditionalStmt {
 protected:
     Stmt *elseBody;
+    int else_scope;
 
     void CheckType();
 
@@ -486,8 +571,16 @@ public:
 };
 
 class BreakStmt : public Stmt {
+protected:
+    Stmt *enclosing;
+
 public:
-    BreakStmt(yyltype loc) : Stmt(loc) {}
+    BreakStmt(yyltype loc) : Stmt(loc) {
+        kind = NK_BreakStmt;
+        enclosing = NULL;
+    }
+
+    void BuildSymTable();
 
     void Check(checkStep c);
 
@@ -502,6 +595,7 @@ protected:
     IntLiteral *value;
     List<Stmt *> *stmts;
     const char *case_label;
+    int scope;
 
 public:
     CaseStmt(IntLiteral *v, List<Stmt *> *stmts);
@@ -526,10 +620,13 @@ protected:
     Expr *expr;
     List<CaseStmt *> *cases;
     const char *end_switch_label;
+    int scope;
 
 public:
     SwitchStmt(Expr *expr, List<CaseStmt *> *cases);
 
+    static bool classof(const Node *n) { return n->GetKind() == NK_SwitchStmt; }
+
 
     void BuildSymTable();
 
@@ -546,11 +643,14 @@ public:
 class ReturnStmt : public Stmt {
 protected:
     Expr *expr;
+    FunctionDecl *enclosing;
 
 public:
     ReturnStmt(yyltype loc, Expr *expr);
 
 
+    void BuildSymTable();
+
     void Check(checkStep c);
 
 
@@ -594,6 +694,8 @@ public:
 
 class EmptyExpr : public Expr {
 public:
+    EmptyExpr() : Expr() { kind = NK_EmptyExpr; }
+
     void Check(checkStep c);
 
 
@@ -641,7 +743,7 @@ public:
 
 class StringLiteral : public Expr {
 protected:
-    char *value;
+    const char *value;
 
 public:
     StringLiteral(yyltype loc, const char *val);
@@ -654,7 +756,7 @@ public:
 
 class NullLiteral : public Expr {
 public:
-    NullLiteral(yyltype loc) : Expr(loc) {}
+    NullLiteral(yyltype loc) : Expr(loc) { kind = NK_NullLiteral; }
 
     void Check(checkStep c);
 
@@ -691,9 +793,9 @@ protected:
     void CheckType();
 
 public:
-    ArithmeticExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs, op, rhs) {}
+    ArithmeticExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs, op, rhs) { kind = NK_ArithmeticExpr; }
 
-    ArithmeticExpr(Operator *op, Expr *rhs) : CompoundExpr(op, rhs) {}
+    ArithmeticExpr(Operator *op, Expr *rhs) : CompoundExpr(op, rhs) { kind = NK_ArithmeticExpr; }
 
     void Check(checkStep c);
 
@@ -706,7 +808,7 @@ protected:
     void CheckType();
 
 public:
-    RelationalExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs, op, rhs) {}
+    RelationalExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs, op, rhs) { kind = NK_RelationalExpr; }
 
     void Check(checkStep c);
 
@@ -719,7 +821,7 @@ protected:
     void CheckType();
 
 public:
-    EqualityExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs, op, rhs) {}
+    EqualityExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs, op, rhs) { kind = NK_EqualityExpr; }
 
     void Check(checkStep c);
 
@@ -732,9 +834,9 @@ protected:
     void CheckType();
 
 public:
-    LogicalExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs, op, rhs) {}
+    LogicalExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs, op, rhs) { kind = NK_LogicalExpr; }
 
-    LogicalExpr(Operator *op, Expr *rhs) : CompoundExpr(op, rhs) {}
+    LogicalExpr(Operator *op, Expr *rhs) : CompoundExpr(op, rhs) { kind = NK_LogicalExpr; }
 
     void Check(checkStep c);
 
@@ -747,7 +849,7 @@ protected:
     void CheckType();
 
 public:
-    AssignExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs, op, rhs) {}
+    AssignExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs, op, rhs) { kind = NK_AssignExpr; }
 
     void Check(checkStep c);
 
@@ -765,7 +867,7 @@ protected:
     void CheckType();
 
 public:
-    This(yyltype loc) : Expr(loc) {}
+    This(yyltype loc) : Expr(loc) { kind = NK_This; }
 
     void Check(checkStep c);
 
@@ -870,7 +972,7 @@ public:
 
 class ReadIntegerExpr : public Expr {
 public:
-    ReadIntegerExpr(yyltype loc) : Expr(loc) {}
+    ReadIntegerExpr(yyltype loc) : Expr(loc) { kind = NK_ReadIntegerExpr; }
 
     void Check(checkStep c);
 
@@ -880,7 +982,7 @@ public:
 
 class ReadLineExpr : public Expr {
 public:
-    ReadLineExpr(yyltype loc) : Expr(loc) {}
+    ReadLineExpr(yyltype loc) : Expr(loc) { kind = NK_ReadLineExpr; }
 
     void Check(checkStep c);
 
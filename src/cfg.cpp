@@ -0,0 +1,267 @@
+#include <string.h>
+#include <algorithm>
+#include "cfg.h"
+#include "output.h"
+
+
+CFG::CFG(CodeGenerator *c, TacFunction *f) : cg(c), fn(f) {
+    BuildBlocks();
+    ComputeOrder();
+    ComputeDominators();
+    FindLoops();
+}
+
+CFG::~CFG() {
+    for (size_t i = 0; i < blocks.size(); i++)
+        delete blocks[i];
+    for (size_t i = 0; i < loops.size(); i++)
+        delete loops[i];
+}
+
+const char *CFG::GetName() const {
+    const std::vector<TacInstr> &code = fn->code;
+    if (!code.empty() && code[0].op == TacLabel)
+        return cg->GetLabel(code[0].imm);
+    return "";
+}
+
+static bool EndsBlock(const TacInstr &ins) {
+    return ins.op == TacGoto || ins.op == TacIfZ || ins.op == TacReturn
+           || ins.op == TacEndFunc;
+}
+
+void CFG::BuildBlocks() {
+    const std::vector<TacInstr> &code = fn->code;
+    Hashtable<BasicBlock *> labelBlock;
+
+    block_of.resize(code.size());
+    for (size_t i = 0; i < code.size(); i++) {
+        // the function's own label starts block 0 rather than a block of
+        // its own; any other label begins a new block
+        bool leader = blocks.empty()
+                      || (code[i].op == TacLabel && i > 0)
+                      || EndsBlock(code[i - 1]);
+        if (leader) {
+            if (!blocks.empty()) blocks.back()->end = i;
+            blocks.push_back(new BasicBlock(blocks.size(), i));
+        }
+        if (code[i].op == TacLabel)
+            labelBlock.Enter(cg->GetLabel(code[i].imm), blocks.back());
+        block_of[i] = blocks.back()->id;
+    }
+    if (!blocks.empty()) blocks.back()->end = code.size();
+
+    for (size_t b = 0; b < blocks.size(); b++) {
+        BasicBlock *bb = blocks[b];
+        const TacInstr &last = code[bb->end - 1];
+        if (last.op == TacGoto || last.op == TacIfZ) {
+            BasicBlock *t = labelBlock.Lookup(cg->GetLabel(last.imm));
+            if (t) bb->succs.push_back(t->id);
+        }
+        if (last.op != TacGoto && last.op != TacReturn
+            && last.op != TacEndFunc && b + 1 < blocks.size()) {
+            if (bb->succs.empty() || bb->succs[0] != (int) b + 1)
+                bb->succs.push_back(b + 1);
+        }
+        for (size_t s = 0; s < bb->succs.size(); s++)
+            blocks[bb->succs[s]]->preds.push_back(b);
+    }
+}
+
+void CFG::ComputeOrder() {
+    int n = blocks.size();
+    std::vector<int> post;
+    std::vector<int> stack, next;
+    std::vector<bool> seen(n, false);
+
+    rpo_num.assign(n, -1);
+    if (n == 0) return;
+    stack.push_back(0);
+    next.push_back(0);
+    seen[0] = true;
+    while (!stack.empty()) {
+        BasicBlock *bb = blocks[stack.back()];
+        int &i = next.back();
+        if (i < (int) bb->succs.size()) {
+            int s = bb->succs[i++];
+            if (!seen[s]) {
+                seen[s] = true;
+                stack.push_back(s);
+                next.push_back(0);
+            }
+        } else {
+            post.push_back(bb->id);
+            stack.pop_back();
+            next.pop_back();
+        }
+    }
+    rpo.assign(post.rbegin(), post.rend());
+    for (size_t i = 0; i < rpo.size(); i++)
+        rpo_num[rpo[i]] = i;
+}
+
+// Cooper, Harvey and Kennedy's iterative algorithm over reverse
+// postorder. The dominator tree is then numbered so Dominates is an
+// interval test, as with the class hierarchy.
+void CFG::ComputeDominators() {
+    int n = blocks.size();
+    std::vector<int> idom(n, -1);
+
+    if (n == 0) return;
+    idom[0] = 0;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t i = 1; i < rpo.size(); i++) {
+            BasicBlock *bb = blocks[rpo[i]];
+            int d = -1;
+            for (size_t p = 0; p < bb->preds.size(); p++) {
+                int q = bb->preds[p];
+                if (idom[q] < 0) continue;
+                if (d < 0) {
+                    d = q;
+                    continue;
+                }
+                while (d != q) {
+                    while (rpo_num[d] > rpo_num[q]) d = idom[d];
+                    while (rpo_num[q] > rpo_num[d]) q = idom[q];
+                }
+            }
+            if (idom[bb->id] != d) {
+                idom[bb->id] = d;
+                changed = true;
+            }
+        }
+    }
+
+    std::vector<std::vector<int> > children(n);
+    for (size_t i = 1; i < rpo.size(); i++) {
+        blocks[rpo[i]]->idom = idom[rpo[i]];
+        children[idom[rpo[i]]].push_back(rpo[i]);
+    }
+
+    dom_pre.assign(n, -1);
+    dom_post.assign(n, -1);
+    int counter = 0;
+    std::vector<int> stack, next;
+    stack.push_back(0);
+    next.push_back(0);
+    dom_pre[0] = counter++;
+    while (!stack.empty()) {
+        int b = stack.back();
+        int &i = next.back();
+        if (i < (int) children[b].size()) {
+            int c = children[b][i++];
+            dom_pre[c] = counter++;
+            stack.push_back(c);
+            next.push_back(0);
+        } else {
+            dom_post[b] = counter++;
+            stack.pop_back();
+            next.pop_back();
+        }
+    }
+}
+
+bool CFG::Dominates(int a, int b) const {
+    if (dom_pre[a] < 0 || dom_pre[b] < 0) return false;
+    return dom_pre[a] <= dom_pre[b] && dom_post[b] <= dom_post[a];
+}
+
+bool Loop::Contains(int b) const {
+    return std::binary_search(blocks.begin(), blocks.end(), b);
+}
+
+void CFG::FindLoops() {
+    std::vector<int> mark(blocks.size(), -1);
+
+    for (size_t i = 0; i < rpo.size(); i++) {
+        BasicBlock *h = blocks[rpo[i]];
+        Loop *l = NULL;
+        for (size_t p = 0; p < h->preds.size(); p++) {
+            int latch = h->preds[p];
+            if (!Dominates(h->id, latch)) continue;
+
+            if (l == NULL) {
+                l = new Loop(h->id);
+                mark[h->id] = loops.size();
+                l->blocks.push_back(h->id);
+                loops.push_back(l);
+            }
+            std::vector<int> work(1, latch);
+            while (!work.empty()) {
+                int b = work.back();
+                work.pop_back();
+                if (mark[b] == (int) loops.size() - 1) continue;
+                mark[b] = loops.size() - 1;
+                l->blocks.push_back(b);
+                for (size_t q = 0; q < blocks[b]->preds.size(); q++)
+                    if (IsReachable(blocks[b]->preds[q]))
+                        work.push_back(blocks[b]->preds[q]);
+            }
+        }
+        if (l) std::sort(l->blocks.begin(), l->blocks.end());
+    }
+
+    // Headers are found in reverse postorder, so an enclosing loop's header
+    // comes before those of the loops nested in it.
+    for (size_t i = 0; i < loops.size(); i++) {
+        Loop *l = loops[i];
+        for (int j = i - 1; j >= 0; j--) {
+            if (loops[j]->Contains(l->header)) {
+                if (l->parent < 0
+                    || loops[j]->blocks.size() < loops[l->parent]->blocks.size())
+                    l->parent = j;
+            }
+        }
+        if (l->parent >= 0) l->depth = loops[l->parent]->depth + 1;
+        for (size_t b = 0; b < l->blocks.size(); b++) {
+            BasicBlock *bb = blocks[l->blocks[b]];
+            if (l->depth > bb->loop_depth) {
+                bb->loop_depth = l->depth;
+                bb->loop = i;
+            }
+        }
+    }
+}
+
+static void WriteEscaped(const char *s) {
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') asmOut.Write("\\", 1);
+        asmOut.Write(s, 1);
+    }
+}
+
+void CFG::DumpDot() {
+    char printed[128];
+
+    asmOut.Printf("digraph \"%s\" {\n", GetName());
+    asmOut.Printf("    node [shape=box, fontname=\"monospace\"];\n");
+    for (size_t b = 0; b < blocks.size(); b++) {
+        BasicBlock *bb = blocks[b];
+        asmOut.Printf("    B%d [label=\"B%d", bb->id, bb->id);
+        if (bb->loop_depth)
+            asmOut.Printf(" (loop depth %d)", bb->loop_depth);
+        if (bb->idom >= 0)
+            asmOut.Printf(" idom B%d", bb->idom);
+        if (!IsReachable(bb->id))
+            asmOut.Printf(" (unreachable)");
+        asmOut.Printf("\\l");
+        for (int i = bb->first; i < bb->end; i++) {
+            cg->Annotate(fn->code[i], printed);
+            if (fn->code[i].op == TacLabel)
+                asmOut.Printf("%s:", cg->GetLabel(fn->code[i].imm));
+            else
+                WriteEscaped(printed);
+            asmOut.Printf("\\l");
+        }
+        asmOut.Printf("\"];\n");
+    }
+    for (size_t b = 0; b < blocks.size(); b++) {
+        BasicBlock *bb = blocks[b];
+        for (size_t s = 0; s < bb->succs.size(); s++)
+            asmOut.Printf("    B%d -> B%d%s;\n", bb->id, bb->succs[s],
+                          Dominates(bb->succs[s], bb->id)
+                          ? " [style=dashed]" : "");
+    }
+    asmOut.Printf("}\n");
+}
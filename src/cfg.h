@@ -0,0 +1,88 @@
+#ifndef _H_cfg
+#define _H_cfg
+
+#include <vector>
+#include "codegen.h"
+
+
+// Instructions [first, end) of a function's TAC; succs/preds hold
+// block ids. idom is -1 for the entry and for unreachable blocks.
+class BasicBlock {
+public:
+    int id;
+    int first, end;
+    std::vector<int> succs, preds;
+    int idom;
+    int loop;
+    int loop_depth;
+
+    BasicBlock(int i, int f) : id(i), first(f), end(f), idom(-1),
+                               loop(-1), loop_depth(0) {}
+};
+
+
+// A natural loop: the header and every block that reaches a back edge
+// into it without passing through the header.
+class Loop {
+public:
+    int header;
+    int parent;
+    int depth;
+    std::vector<int> blocks;
+
+    Loop(int h) : header(h), parent(-1), depth(1) {}
+
+    // blocks is sorted once the loop is found
+    bool Contains(int b) const;
+};
+
+
+class CFG {
+private:
+    CodeGenerator *cg;
+    TacFunction *fn;
+    std::vector<BasicBlock *> blocks;
+    std::vector<int> rpo;
+    std::vector<int> rpo_num;
+    std::vector<int> block_of;
+    std::vector<int> dom_pre, dom_post;
+    std::vector<Loop *> loops;
+
+    void BuildBlocks();
+
+    void ComputeOrder();
+
+    void ComputeDominators();
+
+    void FindLoops();
+
+public:
+    CFG(CodeGenerator *cg, TacFunction *fn);
+
+    ~CFG();
+
+    TacFunction *GetFunction() const { return fn; }
+
+    const char *GetName() const;
+
+    int NumBlocks() const { return blocks.size(); }
+
+    BasicBlock *Block(int i) const { return blocks[i]; }
+
+    int BlockOf(int instr) const { return block_of[instr]; }
+
+    // Reachable blocks in reverse postorder, entry first.
+    const std::vector<int> &ReversePostorder() const { return rpo; }
+
+    bool IsReachable(int b) const { return rpo_num[b] >= 0; }
+
+    bool Dominates(int a, int b) const;
+
+    int NumLoops() const { return loops.size(); }
+
+    Loop *GetLoop(int i) const { return loops[i]; }
+
+    void DumpDot();
+};
+
+#endif
@@ -1,10 +1,14 @@
 
 
 #include "codegen.h"
+#include "intern.h"
+#include "globals.h"
+#include "output.h"
+#include "runtime.h"
+#include "cfg.h"
+#include "dataflow.h"
 #include <string.h>
-#include <iostream>
-#include <fstream>
-#include <sstream>
+#include <limits.h>
 #include <cstring>
 #include <stdarg.h>
 
@@ -15,6 +19,38 @@ CodeGenerator::CodeGenerator() {
     local_loc = OffsetToFirstLocal;
     param_loc = OffsetToFirstParam;
     globl_loc = OffsetToFirstGlobal;
+    begin_func = -1;
+    next_temp = 0;
+    next_label = 0;
+    for (int i = 0; i < NumBuiltIns; i++)
+        builtin_used[i] = false;
+}
+
+TacInstr &CodeGenerator::Code(TacOp op) {
+    if (funcs.empty() || funcs.back()->closed)
+        funcs.push_back(new TacFunction);
+    std::vector<TacInstr> &code = funcs.back()->code;
+    code.push_back(TacInstr());
+    TacInstr &ins = code.back();
+    ins.op = op;
+    ins.code = 0;
+    ins.dst = ins.src1 = ins.src2 = -1;
+    return ins;
+}
+
+int CodeGenerator::OperandId(Location *l) {
+    if (l == NULL) return -1;
+    if (l->GetId() < 0 || l->GetId() >= (int) operands.size()
+        || operands[l->GetId()] != l) {
+        l->SetId(operands.size());
+        operands.push_back(l);
+    }
+    return l->GetId();
+}
+
+int CodeGenerator::LabelId(const char *label) {
+    labels.push_back(Intern(label));
+    return labels.size() - 1;
 }
 
 int CodeGenerator::GetNextLocalLoc() {
@@ -45,109 +81,130 @@ void CodeGenerator::ResetFrameSize() {
 }
 
 char *CodeGenerator::NewLabel() {
-    static int nextLabelNum = 0;
-    char temp[10];
-    sprintf(temp, "_L%d", nextLabelNum++);
+    char temp[16];
+    sprintf(temp, "_L%d", next_label++);
     return strdup(temp);
 }
 
 Location *CodeGenerator::GenTempVar() {
-    static int nextTempNum;
-    char temp[10];
-    Location *result = NULL;
-    sprintf(temp, "_tmp%d", nextTempNum++);
-
-    result = new Location(fpRelative, GetNextLocalLoc(), temp);
-
-    return result;
+    return new Location(fpRelative, GetNextLocalLoc(), next_temp++);
 }
 
 Location *CodeGenerator::GenLoadConstant(int value) {
     Location *result = GenTempVar();
-    code.push_back(new LoadConstant(result, value));
+    TacInstr &ins = Code(TacLoadConstant);
+    ins.dst = OperandId(result);
+    ins.imm = value;
     return result;
 }
 
 Location *CodeGenerator::GenLoadConstant(const char *s) {
     Location *result = GenTempVar();
-    code.push_back(new LoadStringLiteral(result, s));
+    const char *quote = (*s == '"') ? "" : "\"";
+    char *str = new char[strlen(s) + 2 * strlen(quote) + 1];
+    sprintf(str, "%s%s%s", quote, s, quote);
+    strings.push_back(str);
+    TacInstr &ins = Code(TacLoadStringLiteral);
+    ins.dst = OperandId(result);
+    ins.imm = strings.size() - 1;
     return result;
 }
 
 Location *CodeGenerator::GenLoadLabel(const char *label) {
     Location *result = GenTempVar();
-    code.push_back(new LoadLabel(result, label));
+    TacInstr &ins = Code(TacLoadLabel);
+    ins.dst = OperandId(result);
+    ins.imm = LabelId(label);
     return result;
 }
 
 void CodeGenerator::GenAssign(Location *dst, Location *src) {
-    code.push_back(new Assign(dst, src));
+    TacInstr &ins = Code(TacAssign);
+    ins.dst = OperandId(dst);
+    ins.src1 = OperandId(src);
 }
 
 Location *CodeGenerator::GenLoad(Location *ref, int offset) {
     Location *result = GenTempVar();
-    code.push_back(new Load(result, ref, offset));
+    TacInstr &ins = Code(TacLoad);
+    ins.dst = OperandId(result);
+    ins.src1 = OperandId(ref);
+    ins.imm = offset;
     return result;
 }
 
 void CodeGenerator::GenStore(Location *dst, Location *src, int offset) {
-    code.push_back(new Store(dst, src, offset));
+    TacInstr &ins = Code(TacStore);
+    ins.dst = OperandId(dst);
+    ins.src1 = OperandId(src);
+    ins.imm = offset;
 }
 
 Location *CodeGenerator::GenBinaryOp(const char *opName, Location *op1,
                                      Location *op2) {
     Location *result = GenTempVar();
-    code.push_back(new
-                           BinaryOp(BinaryOp::OpCodeForName(opName), result, op1, op2));
+    TacInstr &ins = Code(TacBinaryOp);
+    ins.code = BinaryOp::OpCodeForName(opName);
+    ins.dst = OperandId(result);
+    ins.src1 = OperandId(op1);
+    ins.src2 = OperandId(op2);
     return result;
 }
 
 
 void CodeGenerator::GenLabel(const char *label) {
-    code.push_back(new Label(label));
+    Code(TacLabel).imm = LabelId(label);
 }
 
 void CodeGenerator::GenIfZ(Location *test, const char *label) {
-    code.push_back(new IfZ(test, label));
+    TacInstr &ins = Code(TacIfZ);
+    ins.src1 = OperandId(test);
+    ins.imm = LabelId(label);
 }
 
 void CodeGenerator::GenGoto(const char *label) {
-    code.push_back(new Goto(label));
+    Code(TacGoto).imm = LabelId(label);
 }
 
 void CodeGenerator::GenReturn(Location *val) {
-    code.push_back(new Return(val));
+    Code(TacReturn).src1 = OperandId(val);
 }
 
-BeginFunc *CodeGenerator::GenBeginFunc() {
+void CodeGenerator::GenBeginFunc() {
     ResetFrameSize();
-    BeginFunc *result = new BeginFunc;
-    code.push_back(result);
-    return result;
+    next_temp = 0;
+    Code(TacBeginFunc);
+    begin_func = funcs.back()->code.size() - 1;
 }
 
 void CodeGenerator::GenEndFunc() {
-    code.push_back(new EndFunc());
+    funcs.back()->code[begin_func].imm = GetFrameSize();
+    Code(TacEndFunc);
+    funcs.back()->closed = true;
 }
 
 void CodeGenerator::GenPushParam(Location *param) {
-    code.push_back(new PushParam(param));
+    Code(TacPushParam).src1 = OperandId(param);
 }
 
 void CodeGenerator::GenPopParams(int numBytesOfParams) {
     if (numBytesOfParams > 0)
-        code.push_back(new PopParams(numBytesOfParams));
+        Code(TacPopParams).imm = numBytesOfParams;
 }
 
 Location *CodeGenerator::GenLCall(const char *label, bool fnHasReturnValue) {
     Location *result = fnHasReturnValue ? GenTempVar() : NULL;
-    code.push_back(new LCall(label, result));
+    TacInstr &ins = Code(TacLCall);
+    ins.dst = OperandId(result);
+    ins.imm = LabelId(label);
     return result;
 }
 
 Location *CodeGenerator::GenACall(Location *fnAddr, bool fnHasReturnValue) {
     Location *result = fnHasReturnValue ? GenTempVar() : NULL;
-    code.push_back(new ACall(fnAddr, result));
+    TacInstr &ins = Code(TacACall);
+    ins.dst = OperandId(result);
+    ins.src1 = OperandId(fnAddr);
     return result;
 }
 
@@ -167,129 +224,268 @@ static struct _builtin {
 
 };
 
+int CodeGenerator::BuiltInForLabel(const char *label) {
+    int b = 0;
+    while (b < NumBuiltIns && strcmp(builtins[b].label, label))
+        b++;
+    return b;
+}
+
 Location *CodeGenerator::GenBuiltInCall(BuiltIn bn, Location *arg1,
                                         Location *arg2) {
 
     struct _builtin *b = &builtins[bn];
     Location *result = NULL;
+    builtin_used[bn] = true;
 
     if (b->hasReturn) result = GenTempVar();
-    if (arg2) code.push_back(new PushParam(arg2));
-    if (arg1) code.push_back(new PushParam(arg1));
-    code.push_back(new LCall(b->label, result));
+    if (arg2) GenPushParam(arg2);
+    if (arg1) GenPushParam(arg1);
+    TacInstr &ins = Code(TacLCall);
+    ins.dst = OperandId(result);
+    ins.imm = LabelId(b->label);
     GenPopParams(VarSize * b->numArgs);
     return result;
 }
 
 void CodeGenerator::GenVTable(const char *className,
                               List<const char *> *methodLabels) {
-    code.push_back(new VTable(className, methodLabels));
+    vtables.push_back(std::make_pair(Intern(className), methodLabels));
+    Code(TacVTable).imm = vtables.size() - 1;
+    funcs.back()->closed = true;
 }
 
-void CodeGenerator::DoFinalCodeGen() {
-
-    Mips mips;
-    mips.EmitPreamble();
-
-    std::list<Instruction *>::iterator p;
-    for (p = code.begin(); p != code.end(); ++p) {
-        (*p)->Emit(&mips);
+void CodeGenerator::DumpCFGs() {
+    for (size_t f = 0; f < funcs.size(); f++) {
+        std::vector<TacInstr> &code = funcs[f]->code;
+        if (code.size() < 2 || code[1].op != TacBeginFunc) continue;
+        CFG cfg(this, funcs[f]);
+        cfg.DumpDot();
     }
-
-    printf("    # Prewritten asm\n");
-    std::ifstream i("./src/builtin.asm");
-    std::stringstream buf;
-    buf << i.rdbuf();
-    printf("%s", buf.str().c_str());
 }
 
+void CodeGenerator::DoFinalCodeGen() {
+    if (dump_cfg) {
+        DumpCFGs();
+        return;
+    }
+    if (dump_tac) {
+        WriteTac();
+        return;
+    }
 
-Location::Location(Segment s, int o, const char *name) :
-        variableName(strdup(name)), segment(s), offset(o), base(NULL) {}
-
-Location::Location(Segment s, int o, const char *name, Location *b) :
-        variableName(strdup(name)), segment(s), offset(o), base(b) {}
-
-
-void Instruction::Emit(Mips *mips) {
-    Mips::CurrentInstruction ci(*mips, this);
-    if (*printed)
-        mips->Emit("# %s", printed);
-    EmitSpecific(mips);
-}
+    Mips mips;
+    mips.EmitPreamble();
 
-LoadConstant::LoadConstant(Location *d, int v)
-        : dst(d), val(v) {
-    ;
-    sprintf(printed, "%s = %d", dst->GetName(), val);
-}
+    for (size_t f = 0; f < funcs.size(); f++) {
+        std::vector<TacInstr> &code = funcs[f]->code;
+        if (code.size() < 2 || code[1].op != TacBeginFunc) {
+            for (size_t i = 0; i < code.size(); i++)
+                EmitInstr(&mips, code[i]);
+            continue;
+        }
 
-void LoadConstant::EmitSpecific(Mips *mips) {
-    mips->EmitLoadConstant(dst, val);
-}
+        // values no later instruction reads are dropped from their
+        // registers instead of being written back
+        CFG cfg(this, funcs[f]);
+        Variables vars(this, &cfg);
+        std::vector<unsigned char> dead;
+        vars.FindDeadValues(dead);
+        std::vector<TacHome> &homes = funcs[f]->homes;
+        for (size_t h = 0; h < homes.size(); h++)
+            mips.SetHome(operands[homes[h].operand], homes[h].reg,
+                         homes[h].load);
+        for (size_t i = 0; i < code.size(); i++) {
+            EmitInstr(&mips, code[i], dead[i]);
+            if (dead[i] & 1) mips.DiscardValue(vars.GetLocation(vars.Def(i)));
+            for (int k = 0; k < 2; k++)
+                if (dead[i] & (2 << k))
+                    mips.DiscardValue(vars.GetLocation(vars.Use(i, k)));
+        }
+        mips.ClearHomes();
+    }
 
-LoadStringLiteral::LoadStringLiteral(Location *d, const char *s)
-        : dst(d) {
-    ;
-    const char *quote = (*s == '"') ? "" : "\"";
-    str = new char[strlen(s) + 2 * strlen(quote) + 1];
-    sprintf(str, "%s%s%s", quote, s, quote);
-    quote = (strlen(str) > 50) ? "...\"" : "";
-    sprintf(printed, "%s = %.50s%s", dst->GetName(), str, quote);
+    if (annotate) asmOut.Printf("    # Prewritten asm\n");
+    bool hasData = false;
+    for (int i = 0; i < NumBuiltIns; i++) {
+        if (!builtin_used[i]) continue;
+        asmOut.Write(runtimeText[i], strlen(runtimeText[i]));
+        asmOut.Write("\n\n", 2);
+        if (runtimeData[i]) hasData = true;
+    }
+    if (hasData) {
+        asmOut.Printf(".data\n");
+        for (int i = 0; i < NumBuiltIns; i++)
+            if (builtin_used[i] && runtimeData[i])
+                asmOut.Write(runtimeData[i], strlen(runtimeData[i]));
+    }
 }
 
-void LoadStringLiteral::EmitSpecific(Mips *mips) {
-    mips->EmitLoadStringLiteral(dst, str);
+void CodeGenerator::Annotate(const TacInstr &ins, char *buf) {
+    const char *dst = ins.dst >= 0 ? operands[ins.dst]->GetName() : "";
+    const char *src1 = ins.src1 >= 0 ? operands[ins.src1]->GetName() : "";
+    switch (ins.op) {
+        case TacLoadConstant:
+            sprintf(buf, "%s = %d", dst, ins.imm);
+            break;
+        case TacLoadStringLiteral: {
+            const char *str = strings[ins.imm];
+            sprintf(buf, "%s = %.50s%s", dst, str,
+                    strlen(str) > 50 ? "...\"" : "");
+            break;
+        }
+        case TacLoadLabel:
+            sprintf(buf, "%s = %s", dst, labels[ins.imm]);
+            break;
+        case TacAssign:
+            sprintf(buf, "%s = %s", dst, src1);
+            break;
+        case TacLoad:
+            if (ins.imm)
+                sprintf(buf, "%s = *(%s + %d)", dst, src1, ins.imm);
+            else
+                sprintf(buf, "%s = *(%s)", dst, src1);
+            break;
+        case TacStore:
+            if (ins.imm)
+                sprintf(buf, "*(%s + %d) = %s", dst, ins.imm, src1);
+            else
+                sprintf(buf, "*(%s) = %s", dst, src1);
+            break;
+        case TacBinaryOp:
+            sprintf(buf, "%s = %s %s %s", dst, src1,
+                    BinaryOp::opName[ins.code], operands[ins.src2]->GetName());
+            break;
+        case TacLabel:
+            *buf = '\0';
+            break;
+        case TacGoto:
+            sprintf(buf, "Goto %s", labels[ins.imm]);
+            break;
+        case TacIfZ:
+            sprintf(buf, "IfZ %s Goto %s", src1, labels[ins.imm]);
+            break;
+        case TacBeginFunc:
+            sprintf(buf, "BeginFunc %d", ins.imm);
+            break;
+        case TacEndFunc:
+            sprintf(buf, "EndFunc");
+            break;
+        case TacReturn:
+            sprintf(buf, "Return %s", src1);
+            break;
+        case TacPushParam:
+            sprintf(buf, "PushParam %s", src1);
+            break;
+        case TacPopParams:
+            sprintf(buf, "PopParams %d", ins.imm);
+            break;
+        case TacLCall:
+            sprintf(buf, "%s%sLCall %s", dst, ins.dst >= 0 ? " = " : "",
+                    labels[ins.imm]);
+            break;
+        case TacACall:
+            sprintf(buf, "%s%sACall %s", dst, ins.dst >= 0 ? " = " : "", src1);
+            break;
+        case TacVTable:
+            sprintf(buf, "VTable for class %s", vtables[ins.imm].first);
+            break;
+    }
 }
 
-LoadLabel::LoadLabel(Location *d, const char *l)
-        : dst(d), label(strdup(l)) {
-    ;
-    sprintf(printed, "%s = %s", dst->GetName(), label);
-}
+void CodeGenerator::EmitInstr(Mips *mips, const TacInstr &ins, int dead) {
+    if (annotate) {
+        char printed[128];
+        Annotate(ins, printed);
+        if (*printed)
+            mips->Emit("# %s", printed);
+    }
 
-void LoadLabel::EmitSpecific(Mips *mips) {
-    mips->EmitLoadLabel(dst, label);
+    Location *dst = ins.dst >= 0 ? operands[ins.dst] : NULL;
+    Location *src1 = ins.src1 >= 0 ? operands[ins.src1] : NULL;
+    switch (ins.op) {
+        case TacLoadConstant:
+            mips->EmitLoadConstant(dst, ins.imm);
+            break;
+        case TacLoadStringLiteral:
+            mips->EmitLoadStringLiteral(dst, strings[ins.imm]);
+            break;
+        case TacLoadLabel:
+            mips->EmitLoadLabel(dst, labels[ins.imm]);
+            break;
+        case TacAssign:
+            mips->EmitCopy(dst, src1);
+            break;
+        case TacLoad:
+            mips->EmitLoad(dst, src1, ins.imm);
+            break;
+        case TacStore:
+            mips->EmitStore(dst, src1, ins.imm);
+            break;
+        case TacBinaryOp:
+            mips->EmitBinaryOp((BinaryOp::OpCode) ins.code, dst, src1,
+                               operands[ins.src2]);
+            break;
+        case TacLabel:
+            mips->EmitLabel(labels[ins.imm]);
+            break;
+        case TacGoto:
+            mips->EmitGoto(labels[ins.imm]);
+            break;
+        case TacIfZ:
+            mips->EmitIfZ(src1, labels[ins.imm], dead & 2);
+            break;
+        case TacBeginFunc:
+            mips->EmitBeginFunction(ins.imm);
+            break;
+        case TacEndFunc:
+            mips->EmitEndFunction();
+            break;
+        case TacReturn:
+            mips->EmitReturn(src1);
+            break;
+        case TacPushParam:
+            mips->EmitParam(src1);
+            break;
+        case TacPopParams:
+            mips->EmitPopParams(ins.imm);
+            break;
+        case TacLCall:
+            mips->EmitLCall(dst, labels[ins.imm]);
+            break;
+        case TacACall:
+            mips->EmitACall(dst, src1);
+            break;
+        case TacVTable:
+            mips->EmitVTable(vtables[ins.imm].first, vtables[ins.imm].second);
+            break;
+    }
 }
 
 
-Assign::Assign(Location *d, Location *s)
-        : dst(d), src(s) {
-    ;
-    sprintf(printed, "%s = %s", dst->GetName(), src->GetName());
-}
-
-void Assign::EmitSpecific(Mips *mips) {
-    mips->EmitCopy(dst, src);
-}
+Location::Location(Segment s, int o, const char *name) :
+        variableName(Intern(name)), segment(s), offset(o), base(NULL),
+        reg(-1), id(-1) {}
 
-Load::Load(Location *d, Location *s, int off)
-        : dst(d), src(s), offset(off) {
-    ;
-    if (offset)
-        sprintf(printed, "%s = *(%s + %d)", dst->GetName(), src->GetName(),
-                offset);
-    else
-        sprintf(printed, "%s = *(%s)", dst->GetName(), src->GetName());
-}
+Location::Location(Segment s, int o, const char *name, Location *b) :
+        variableName(Intern(name)), segment(s), offset(o), base(b),
+        reg(-1), id(-1) {}
 
-void Load::EmitSpecific(Mips *mips) {
-    mips->EmitLoad(dst, src, offset);
-}
+Location::Location(Segment s, int o, int r) :
+        variableName(NULL), segment(s), offset(o), base(NULL),
+        reg(r), id(-1) {}
 
-Store::Store(Location *d, Location *s, int off)
-        : dst(d), src(s), offset(off) {
-    ;
-    if (offset)
-        sprintf(printed, "*(%s + %d) = %s", dst->GetName(), offset,
-                src->GetName());
-    else
-        sprintf(printed, "*(%s) = %s", dst->GetName(), src->GetName());
+// Temps have no stored name; it is formatted on demand into one of a few
+// rotating buffers so a single printf can mention several temps.
+const char *Location::GetName() const {
+    static char names[4][16];
+    static int next = 0;
+    if (variableName) return variableName;
+    char *buf = names[next++ % 4];
+    sprintf(buf, "_tmp%d", reg);
+    return buf;
 }
 
-void Store::EmitSpecific(Mips *mips) {
-    mips->EmitStore(dst, src, offset);
-}
 
 const char *const BinaryOp::opName[BinaryOp::NumOps] = {
         "+", "-", "*", "/", "%",
@@ -305,186 +501,203 @@ BinaryOp::OpCode BinaryOp::OpCodeForName(const char *name) {
     return Add;
 }
 
-BinaryOp::BinaryOp(OpCode c, Location *d, Location *o1, Location *o2)
-        : code(c), dst(d), op1(o1), op2(o2) {
-    ;;
-    sprintf(printed, "%s = %s %s %s", dst->GetName(), op1->GetName(),
-            opName[code], op2->GetName());
+bool BinaryOp::Fold(OpCode code, int a, int b, int &c) {
+    unsigned int ua = a, ub = b;
+    switch (code) {
+        case Add: c = (int) (ua + ub); break;
+        case Sub: c = (int) (ua - ub); break;
+        case Mul: c = (int) (ua * ub); break;
+        case Div:
+        case Mod:
+            if (b == 0 || (a == INT_MIN && b == -1)) return false;
+            c = code == Div ? a / b : a % b;
+            break;
+        case Eq: c = a == b; break;
+        case Ne: c = a != b; break;
+        case Lt: c = a < b; break;
+        case Le: c = a <= b; break;
+        case Gt: c = a > b; break;
+        case Ge: c = a >= b; break;
+        case And: c = a & b; break;
+        case Or: c = a | b; break;
+        default: return false;
+    }
+    return true;
 }
 
-void BinaryOp::EmitSpecific(Mips *mips) {
-    mips->EmitBinaryOp(code, dst, op1, op2);
-}
 
-Label::Label(const char *l) : label(strdup(l)) {
-    ;
-    *printed = '\0';
+static bool LocationsAreSame(Location *var1, Location *var2) {
+    return (var1 == var2 ||
+            (var1 && var2
+             && var1->GetReg() == var2->GetReg()
+             && (var1->IsTemp() || var1->GetName() == var2->GetName())
+             && var1->GetSegment() == var2->GetSegment()
+             && var1->GetOffset() == var2->GetOffset()));
 }
 
 
-void Label::EmitSpecific(Mips *mips) {
-    mips->EmitLabel(label);
-}
-
-Goto::Goto(const char *l) : label(strdup(l)) {
+void Mips::SpillRegister(Location *dst, Register reg) {
     ;
-    sprintf(printed, "Goto %s", label);
+    const char *offsetFromWhere = dst->GetSegment() == fpRelative
+                                  ? regs[fp].name : regs[gp].name;;
+    Emit("sw %s, %d(%s)\t# spill %s from %s to %s%+d", regs[reg].name,
+         dst->GetOffset(), offsetFromWhere, dst->GetName(), regs[reg].name,
+         offsetFromWhere, dst->GetOffset());
 }
 
-void Goto::EmitSpecific(Mips *mips) {
-    mips->EmitGoto(label);
-}
 
-IfZ::IfZ(Location *te, const char *l)
-        : test(te), label(strdup(l)) {
+void Mips::FillRegister(Location *src, Register reg) {
     ;
-    sprintf(printed, "IfZ %s Goto %s", test->GetName(), label);
-}
-
-void IfZ::EmitSpecific(Mips *mips) {
-    mips->EmitIfZ(test, label);
-}
-
-BeginFunc::BeginFunc() {
-    sprintf(printed, "BeginFunc (unassigned)");
-    frameSize = -555;
-}
-
-void BeginFunc::SetFrameSize(int numBytesForAllLocalsAndTemps) {
-    frameSize = numBytesForAllLocalsAndTemps;
-    sprintf(printed, "BeginFunc %d", frameSize);
-}
-
-void BeginFunc::EmitSpecific(Mips *mips) {
-    mips->EmitBeginFunction(frameSize);
-}
-
-EndFunc::EndFunc() : Instruction() {
-    sprintf(printed, "EndFunc");
+    const char *offsetFromWhere = src->GetSegment() == fpRelative
+                                  ? regs[fp].name : regs[gp].name;;
+    Emit("lw %s, %d(%s)\t# fill %s to %s from %s%+d", regs[reg].name,
+         src->GetOffset(), offsetFromWhere, src->GetName(), regs[reg].name,
+         offsetFromWhere, src->GetOffset());
 }
 
-void EndFunc::EmitSpecific(Mips *mips) {
-    mips->EmitEndFunction();
-}
 
-Return::Return(Location *v) : val(v) {
-    sprintf(printed, "Return %s", val ? val->GetName() : "");
+bool Mips::FindRegisterWithContents(Location *var, Register &reg) {
+    for (int r = 0; r < NumRegs; r++)
+        if (regs[r].isGeneralPurpose && regs[r].var
+            && LocationsAreSame(var, regs[r].var)) {
+            reg = (Register) r;
+            return true;
+        }
+    return false;
 }
 
-void Return::EmitSpecific(Mips *mips) {
-    mips->EmitReturn(val);
-}
 
-PushParam::PushParam(Location *p)
-        : param(p) {
-    ;
-    sprintf(printed, "PushParam %s", param->GetName());
+// An empty register if there is one, else a clean one, else the next
+// dirty one in turn.
+Mips::Register Mips::SelectRegisterToSpill(Register avoid1, Register avoid2) {
+    Register clean = zero, dirty = zero;
+    for (int i = 0; i < NumRegs; i++) {
+        Register r = (Register) ((next_spill + i) % NumRegs);
+        if (!regs[r].isGeneralPurpose || r == avoid1 || r == avoid2)
+            continue;
+        if (!regs[r].var) return r;
+        if (!regs[r].isDirty && clean == zero) clean = r;
+        if (regs[r].isDirty && dirty == zero) dirty = r;
+    }
+    Register r = clean != zero ? clean : dirty;
+    next_spill = (r + 1) % NumRegs;
+    return r;
 }
 
-void PushParam::EmitSpecific(Mips *mips) {
-    mips->EmitParam(param);
-}
 
-PopParams::PopParams(int nb)
-        : numBytes(nb) {
-    sprintf(printed, "PopParams %d", numBytes);
+Mips::Register Mips::HomeRegister(int home) {
+    return (Register) (home < NumTempHomes ? t3 + home
+                                           : s0 + home - NumTempHomes);
 }
 
-void PopParams::EmitSpecific(Mips *mips) {
-    mips->EmitPopParams(numBytes);
-}
 
-LCall::LCall(const char *l, Location *d)
-        : label(strdup(l)), dst(d) {
-    sprintf(printed, "%s%sLCall %s", dst ? dst->GetName() : "", dst ? " = " : "",
-            label);
+void Mips::SetHome(Location *var, int h, bool load) {
+    Register reg = HomeRegister(h);
+    if (var->GetId() >= (int) home.size()) home.resize(var->GetId() + 1, -1);
+    home[var->GetId()] = reg;
+    homed.push_back(var);
+    regs[reg].isGeneralPurpose = false;
+    if (h >= NumTempHomes) saved_homes |= 1u << (reg - s0);
+    if (load) entry_loads.push_back(var);
 }
 
-void LCall::EmitSpecific(Mips *mips) {
-    mips->EmitLCall(dst, label);
-}
 
-ACall::ACall(Location *ma, Location *d)
-        : dst(d), methodAddr(ma) {
-    ;
-    sprintf(printed, "%s%sACall %s", dst ? dst->GetName() : "", dst ? " = " : "",
-            methodAddr->GetName());
+void Mips::ClearHomes() {
+    for (size_t i = 0; i < homed.size(); i++)
+        home[homed[i]->GetId()] = -1;
+    homed.clear();
+    entry_loads.clear();
+    saved_homes = 0;
+    for (int r = t0; r <= t9; r++)
+        regs[r].isGeneralPurpose = true;
 }
 
-void ACall::EmitSpecific(Mips *mips) {
-    mips->EmitACall(dst, methodAddr);
-}
 
-VTable::VTable(const char *l, List<const char *> *m)
-        : methodLabels(m), label(strdup(l)) {
-    ;
-    sprintf(printed, "VTable for class %s", l);
+bool Mips::FindHome(Location *var, Register &reg) {
+    int id = var->GetId();
+    if (id < 0 || id >= (int) home.size() || home[id] < 0) return false;
+    reg = (Register) home[id];
+    return true;
 }
 
 
-void VTable::EmitSpecific(Mips *mips) {
-    mips->EmitVTable(label, methodLabels);
+Mips::Register Mips::GetRegister(Location *var, Reason reason,
+                                 Register avoid1, Register avoid2) {
+    Register reg;
+    if (FindHome(var, reg)) return reg;
+    if (!FindRegisterWithContents(var, reg)) {
+        reg = SelectRegisterToSpill(avoid1, avoid2);
+        if (regs[reg].isDirty) SpillRegister(regs[reg].var, reg);
+        regs[reg].var = var;
+        regs[reg].isDirty = false;
+        if (reason == ForRead) FillRegister(var, reg);
+    }
+    if (reason == ForWrite) regs[reg].isDirty = true;
+    return reg;
 }
 
 
-static bool LocationsAreSame(Location *var1, Location *var2) {
-    return (var1 == var2 ||
-            (var1 && var2
-             && !strcmp(var1->GetName(), var2->GetName())
-             && var1->GetSegment() == var2->GetSegment()
-             && var1->GetOffset() == var2->GetOffset()));
+void Mips::SpillDirtyRegisters(bool globalsOnly) {
+    for (int r = 0; r < NumRegs; r++) {
+        if (!regs[r].isDirty) continue;
+        if (globalsOnly && regs[r].var->GetSegment() != gpRelative) continue;
+        SpillRegister(regs[r].var, (Register) r);
+        regs[r].isDirty = false;
+    }
 }
 
 
-void Mips::SpillRegister(Location *dst, Register reg) {
-    ;
-    const char *offsetFromWhere = dst->GetSegment() == fpRelative
-                                  ? regs[fp].name : regs[gp].name;;
-    Emit("sw %s, %d(%s)\t# spill %s from %s to %s%+d", regs[reg].name,
-         dst->GetOffset(), offsetFromWhere, dst->GetName(), regs[reg].name,
-         offsetFromWhere, dst->GetOffset());
+void Mips::DiscardValue(Location *var) {
+    Register reg;
+    if (FindRegisterWithContents(var, reg)) {
+        regs[reg].var = NULL;
+        regs[reg].isDirty = false;
+    }
 }
 
 
-void Mips::FillRegister(Location *src, Register reg) {
-    ;
-    const char *offsetFromWhere = src->GetSegment() == fpRelative
-                                  ? regs[fp].name : regs[gp].name;;
-    Emit("lw %s, %d(%s)\t# fill %s to %s from %s%+d", regs[reg].name,
-         src->GetOffset(), offsetFromWhere, src->GetName(), regs[reg].name,
-         offsetFromWhere, src->GetOffset());
+void Mips::DiscardRegisters() {
+    for (int r = 0; r < NumRegs; r++) {
+        regs[r].var = NULL;
+        regs[r].isDirty = false;
+    }
 }
 
 
+// Comments in fmt start at the first '#'. Unless annotating, the format is
+// cut there before formatting, so comment arguments are never printed.
 void Mips::Emit(const char *fmt, ...) {
     va_list args;
     char buf[1024];
+    char code[256];
+
+    if (!annotate) {
+        const char *c = strchr(fmt, '#');
+        if (c) {
+            while (c > fmt && (c[-1] == '\t' || c[-1] == ' ')) c--;
+            if (c == fmt) return;
+            memcpy(code, fmt, c - fmt);
+            code[c - fmt] = 0;
+            fmt = code;
+        }
+    }
 
     va_start(args, fmt);
-    vsprintf(buf, fmt, args);
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
     va_end(args);
+    if (n >= (int) sizeof(buf) - 1) n = sizeof(buf) - 2;
 
-    for (int i = 1023; i >= 0; i--) {
-
-
-        if (buf[i] == '#' && buf[i + 1] == ' ') {
-            buf[i] = 0;
-            break;
-        }
-    }
-
-    if (buf[strlen(buf) - 1] != ':') printf("\t");
-    if (buf[0] != '#') printf("  ");
-    printf("%s", buf);
-    if (buf[strlen(buf) - 1] != '\n') printf("\n");
+    if (buf[n - 1] != ':') asmOut.Write("\t", 1);
+    if (buf[0] != '#') asmOut.Write("  ", 2);
+    if (buf[n - 1] != '\n') buf[n++] = '\n';
+    asmOut.Write(buf, n);
 }
 
 
 void Mips::EmitLoadConstant(Location *dst, int val) {
-    Register r = rd;
+    Register r = GetRegister(dst, ForWrite);
     Emit("li %s, %d\t\t# load constant value %d into %s", regs[r].name,
          val, val, regs[r].name);
-    SpillRegister(dst, rd);
 }
 
 
@@ -500,28 +713,31 @@ void Mips::EmitLoadStringLiteral(Location *dst, const char *str) {
 
 
 void Mips::EmitLoadLabel(Location *dst, const char *label) {
-    Emit("la %s, %s\t# load label", regs[rd].name, label);
-    SpillRegister(dst, rd);
+    Register r = GetRegister(dst, ForWrite);
+    Emit("la %s, %s\t# load label", regs[r].name, label);
 }
 
 
 void Mips::EmitCopy(Location *dst, Location *src) {
-    FillRegister(src, rd);
-    SpillRegister(dst, rd);
+    Register rs = GetRegister(src);
+    Register rd = GetRegister(dst, ForWrite, rs);
+    if (rd != rs)
+        Emit("move %s, %s\t\t# copy %s to %s", regs[rd].name, regs[rs].name,
+             src->GetName(), dst->GetName());
 }
 
 
 void Mips::EmitLoad(Location *dst, Location *reference, int offset) {
-    FillRegister(reference, rs);
+    Register rs = GetRegister(reference);
+    Register rd = GetRegister(dst, ForWrite, rs);
     Emit("lw %s, %d(%s) \t# load with offset", regs[rd].name,
          offset, regs[rs].name);
-    SpillRegister(dst, rd);
 }
 
 
 void Mips::EmitStore(Location *reference, Location *value, int offset) {
-    FillRegister(value, rs);
-    FillRegister(reference, rd);
+    Register rs = GetRegister(value);
+    Register rd = GetRegister(reference, ForRead, rs);
     Emit("sw %s, %d(%s) \t# store with offset",
          regs[rs].name, offset, regs[rd].name);
 }
@@ -529,26 +745,32 @@ void Mips::EmitStore(Location *reference, Location *value, int offset) {
 
 void Mips::EmitBinaryOp(BinaryOp::OpCode code, Location *dst,
                         Location *op1, Location *op2) {
-    FillRegister(op1, rs);
-    FillRegister(op2, rt);
+    Register rs = GetRegister(op1);
+    Register rt = GetRegister(op2, ForRead, rs);
+    Register rd = GetRegister(dst, ForWrite, rs, rt);
     Emit("%s %s, %s, %s\t", NameForTac(code), regs[rd].name,
          regs[rs].name, regs[rt].name);
-    SpillRegister(dst, rd);
 }
 
 
 void Mips::EmitLabel(const char *label) {
+    SpillDirtyRegisters();
+    DiscardRegisters();
     Emit("%s:", label);
 }
 
 
 void Mips::EmitGoto(const char *label) {
+    SpillDirtyRegisters();
     Emit("b %s\t\t# unconditional branch", label);
+    DiscardRegisters();
 }
 
 
-void Mips::EmitIfZ(Location *test, const char *label) {
-    FillRegister(test, rs);
+void Mips::EmitIfZ(Location *test, const char *label, bool testDies) {
+    Register rs = GetRegister(test);
+    if (testDies && regs[rs].var == test) regs[rs].isDirty = false;
+    SpillDirtyRegisters();
     Emit("beqz %s, %s\t# branch if %s is zero ", regs[rs].name, label,
          test->GetName());
 }
@@ -556,17 +778,19 @@ void Mips::EmitIfZ(Location *test, const char *label) {
 
 void Mips::EmitParam(Location *arg) {
     Emit("subu $sp, $sp, 4\t# decrement sp to make space for param");
-    FillRegister(arg, rs);
+    Register rs = GetRegister(arg);
     Emit("sw %s, 4($sp)\t# copy param value to stack", regs[rs].name);
 }
 
 
 void Mips::EmitCallInstr(Location *result, const char *fn, bool isLabel) {
+    SpillDirtyRegisters();
     Emit("%s %-15s\t# jump to function", isLabel ? "jal" : "jalr", fn);
+    DiscardRegisters();
     if (result != NULL) {
+        Register rd = GetRegister(result, ForWrite);
         Emit("move %s, %s\t\t# copy function return value from $v0",
              regs[rd].name, regs[v0].name);
-        SpillRegister(result, rd);
     }
 }
 
@@ -576,7 +800,7 @@ void Mips::EmitLCall(Location *dst, const char *label) {
 }
 
 void Mips::EmitACall(Location *dst, Location *fn) {
-    FillRegister(fn, rs);
+    Register rs = GetRegister(fn);
     EmitCallInstr(dst, regs[rs].name, false);
 }
 
@@ -589,14 +813,22 @@ void Mips::EmitPopParams(int bytes) {
 
 void Mips::EmitReturn(Location *returnVal) {
     if (returnVal != NULL) {
-        FillRegister(returnVal, rd);
+        Register rd = GetRegister(returnVal);
         Emit("move $v0, %s\t\t# assign return value into $v0",
              regs[rd].name);
     }
+    SpillDirtyRegisters(true);
+    for (int r = s0, slot = saved_offset; r <= s7; r++)
+        if (saved_homes & (1u << (r - s0))) {
+            Emit("lw %s, %d($fp)\t# restore %s", regs[r].name, slot,
+                 regs[r].name);
+            slot -= 4;
+        }
     Emit("move $sp, $fp\t\t# pop callee frame off stack");
     Emit("lw $ra, -4($fp)\t# restore saved ra");
     Emit("lw $fp, 0($fp)\t# restore saved fp");
     Emit("jr $ra\t\t# return from function");
+    DiscardRegisters();
 }
 
 
@@ -607,10 +839,25 @@ void Mips::EmitBeginFunction(int stackFrameSize) {
     Emit("sw $ra, 4($sp)\t# save ra");
     Emit("addiu $fp, $sp, 8\t# set up new fp");
 
+    // callee-saved homes are kept just below the locals
+    saved_offset = CodeGenerator::OffsetToFirstLocal - stackFrameSize;
+    for (int r = s0; r <= s7; r++)
+        if (saved_homes & (1u << (r - s0))) stackFrameSize += 4;
     if (stackFrameSize != 0)
         Emit(
                 "subu $sp, $sp, %d\t# decrement sp to make space for locals/temps",
                 stackFrameSize);
+    for (int r = s0, slot = saved_offset; r <= s7; r++)
+        if (saved_homes & (1u << (r - s0))) {
+            Emit("sw %s, %d($fp)\t# save %s", regs[r].name, slot,
+                 regs[r].name);
+            slot -= 4;
+        }
+    for (size_t i = 0; i < entry_loads.size(); i++) {
+        Register reg;
+        FindHome(entry_loads[i], reg);
+        FillRegister(entry_loads[i], reg);
+    }
 }
 
 
@@ -683,17 +930,17 @@ Mips::Mips() {
     regs[t7] = (RegContents) {false, NULL, "$t7", true};
     regs[t8] = (RegContents) {false, NULL, "$t8", true};
     regs[t9] = (RegContents) {false, NULL, "$t9", true};
-    regs[s0] = (RegContents) {false, NULL, "$s0", true};
-    regs[s1] = (RegContents) {false, NULL, "$s1", true};
-    regs[s2] = (RegContents) {false, NULL, "$s2", true};
-    regs[s3] = (RegContents) {false, NULL, "$s3", true};
-    regs[s4] = (RegContents) {false, NULL, "$s4", true};
-    regs[s5] = (RegContents) {false, NULL, "$s5", true};
-    regs[s6] = (RegContents) {false, NULL, "$s6", true};
-    regs[s7] = (RegContents) {false, NULL, "$s7", true};
-    rs = t0;
-    rt = t1;
-    rd = t2;
+    regs[s0] = (RegContents) {false, NULL, "$s0", false};
+    regs[s1] = (RegContents) {false, NULL, "$s1", false};
+    regs[s2] = (RegContents) {false, NULL, "$s2", false};
+    regs[s3] = (RegContents) {false, NULL, "$s3", false};
+    regs[s4] = (RegContents) {false, NULL, "$s4", false};
+    regs[s5] = (RegContents) {false, NULL, "$s5", false};
+    regs[s6] = (RegContents) {false, NULL, "$s6", false};
+    regs[s7] = (RegContents) {false, NULL, "$s7", false};
+    next_spill = t0;
+    saved_homes = 0;
+    saved_offset = 0;
 }
 
 const char *Mips::mipsName[BinaryOp::NumOps];
\ No newline at end of file
@@ -4,8 +4,11 @@
 #define _H_codegen
 
 #include <cstdlib>
-#include <list>
+#include <cstdio>
+#include <vector>
+#include <utility>
 #include "ds.h"
+#include "arena.h"
 
 
 typedef enum {
@@ -17,17 +20,81 @@ class Location;
 
 class Mips;
 
-class Instruction;
 
-class BeginFunc;
+typedef enum {
+    TacLoadConstant, TacLoadStringLiteral, TacLoadLabel, TacAssign,
+    TacLoad, TacStore, TacBinaryOp, TacLabel, TacGoto, TacIfZ,
+    TacBeginFunc, TacEndFunc, TacReturn, TacPushParam, TacPopParams,
+    TacLCall, TacACall, TacVTable, NumTacOps
+} TacOp;
+
+// One three-address instruction. Operands are indices into the code
+// generator's operand table (-1 for none); imm holds a constant, an
+// offset, a byte count or a label/string/vtable index depending on op.
+struct TacInstr {
+    unsigned char op;
+    unsigned char code;
+    int dst;
+    int src1;
+    union {
+        int src2;
+        int imm;
+    };
+};
+
+// A register the allocator gave one of a function's operands; reg
+// numbers Mips's homes. load says the value must be fetched from its
+// stack slot on entry.
+struct TacHome {
+    int operand;
+    int reg;
+    bool load;
+};
+
+struct TacFunction {
+    std::vector<TacInstr> code;
+    std::vector<TacHome> homes;
+    bool closed;
+
+    TacFunction() : closed(false) {}
+};
 
 class CodeGenerator {
 private:
-    std::list<Instruction *> code;
+    std::vector<TacFunction *> funcs;
+    std::vector<Location *> operands;
+    std::vector<const char *> labels;
+    std::vector<const char *> strings;
+    std::vector<std::pair<const char *, List<const char *> *> > vtables;
+    int begin_func;
+    int next_temp;
+    int next_label;
+    bool builtin_used[NumBuiltIns];
     int local_loc;
     int param_loc;
     int globl_loc;
 
+    TacInstr &Code(TacOp op);
+
+    int OperandId(Location *l);
+
+    int LabelId(const char *label);
+
+    void EmitInstr(Mips *mips, const TacInstr &ins, int dead = 0);
+
+    static int BuiltInForLabel(const char *label);
+
+    void WriteOperand(int id);
+
+    int ReadOperand(const char *word, Hashtable<Location *> &locs);
+
+    bool ReadAddress(char *&p, Hashtable<Location *> &locs, int *base,
+                     int *offset);
+
+    void NoteLabel(const char *label);
+
+    bool ReadTacLine(char *line, Hashtable<Location *> &locs);
+
 public:
 
 
@@ -102,7 +169,7 @@ public:
     void GenLabel(const char *label);
 
 
-    BeginFunc *GenBeginFunc();
+    void GenBeginFunc();
 
     void GenEndFunc();
 
@@ -110,6 +177,25 @@ public:
     void GenVTable(const char *className, List<const char *> *methodLabels);
 
 
+    int NumFunctions() const { return funcs.size(); }
+
+    TacFunction *GetFunction(int i) const { return funcs[i]; }
+
+    const char *GetLabel(int id) const { return labels[id]; }
+
+    Location *GetOperand(int id) const { return operands[id]; }
+
+    void Annotate(const TacInstr &ins, char *buf);
+
+    void DumpCFGs();
+
+    // Writes the TAC in the text form ReadTac accepts.
+    void WriteTac();
+
+    // Appends the functions and vtables in a TAC text file; returns false
+    // (after reporting the line) if it does not parse.
+    bool ReadTac(FILE *in);
+
     void DoFinalCodeGen();
 };
 
@@ -124,125 +210,42 @@ protected:
     Segment segment;
     int offset;
     Location *base;
+    int reg;
+    int id;
 
 public:
-    Location(Segment seg, int offset, const char *name);
-
-    Location(Segment seg, int offset, const char *name, Location *base);
+    static void *operator new(size_t size) { return nodeArena.Alloc(size); }
 
-    const char *GetName() const { return variableName; }
-
-    Segment GetSegment() const { return segment; }
-
-    int GetOffset() const { return offset; }
-
-    Location *GetBase() const { return base; }
-
-
-};
+    static void operator delete(void *p) {}
 
+    Location(Segment seg, int offset, const char *name);
 
-class Instruction {
-protected:
-    char printed[128];
-
-public:
-    virtual void EmitSpecific(Mips *mips) = 0;
-
-    void Emit(Mips *mips);
-};
-
-
-class LoadConstant;
-
-class LoadStringLiteral;
-
-class LoadLabel;
-
-class Assign;
-
-class Load;
-
-class Store;
-
-class BinaryOp;
-
-class Label;
-
-class Goto;
-
-class IfZ;
-
-class BeginFunc;
-
-class EndFunc;
-
-class Return;
+    Location(Segment seg, int offset, const char *name, Location *base);
 
-class PushParam;
+    Location(Segment seg, int offset, int reg);
 
-class PopParams;
+    const char *GetName() const;
 
-class LCall;
+    bool IsTemp() const { return reg >= 0; }
 
-class ACall;
+    int GetReg() const { return reg; }
 
-class VTable;
+    Segment GetSegment() const { return segment; }
 
-class LoadConstant : public Instruction {
-    Location *dst;
-    int val;
-public:
-    LoadConstant(Location *dst, int val);
+    int GetOffset() const { return offset; }
 
-    void EmitSpecific(Mips *mips);
-};
+    Location *GetBase() const { return base; }
 
-class LoadStringLiteral : public Instruction {
-    Location *dst;
-    char *str;
-public:
-    LoadStringLiteral(Location *dst, const char *s);
+    int GetId() const { return id; }
 
-    void EmitSpecific(Mips *mips);
-};
+    void SetId(int i) { id = i; }
 
-class LoadLabel : public Instruction {
-    Location *dst;
-    const char *label;
-public:
-    LoadLabel(Location *dst, const char *label);
+    void SetOffset(int o) { offset = o; }
 
-    void EmitSpecific(Mips *mips);
 };
 
-class Assign : public Instruction {
-    Location *dst, *src;
-public:
-    Assign(Location *dst, Location *src);
-
-    void EmitSpecific(Mips *mips);
-};
 
-class Load : public Instruction {
-    Location *dst, *src;
-    int offset;
-public:
-    Load(Location *dst, Location *src, int offset = 0);
-
-    void EmitSpecific(Mips *mips);
-};
-
-class Store : public Instruction {
-    Location *dst, *src;
-    int offset;
-public:
-    Store(Location *d, Location *s, int offset = 0);
-
-    void EmitSpecific(Mips *mips);
-};
-
-class BinaryOp : public Instruction {
+class BinaryOp {
 public:
     typedef enum {
         Add, Sub, Mul, Div, Mod,
@@ -254,111 +257,9 @@ public:
 
     static OpCode OpCodeForName(const char *name);
 
-protected:
-    OpCode code;
-    Location *dst, *op1, *op2;
-public:
-    BinaryOp(OpCode c, Location *dst, Location *op1, Location *op2);
-
-    void EmitSpecific(Mips *mips);
-};
-
-class Label : public Instruction {
-    const char *label;
-public:
-    Label(const char *label);
-
-    void EmitSpecific(Mips *mips);
-
-    const char *text() const { return label; }
-};
-
-class Goto : public Instruction {
-    const char *label;
-public:
-    Goto(const char *label);
-
-    void EmitSpecific(Mips *mips);
-
-    const char *branch_label() const { return label; }
-};
-
-class IfZ : public Instruction {
-    Location *test;
-    const char *label;
-public:
-    IfZ(Location *test, const char *label);
-
-    void EmitSpecific(Mips *mips);
-
-    const char *branch_label() const { return label; }
-};
-
-class BeginFunc : public Instruction {
-    int frameSize;
-public:
-    BeginFunc();
-
-    void SetFrameSize(int numBytesForAllLocalsAndTemps);
-
-    void EmitSpecific(Mips *mips);
-};
-
-class EndFunc : public Instruction {
-public:
-    EndFunc();
-
-    void EmitSpecific(Mips *mips);
-};
-
-class Return : public Instruction {
-    Location *val;
-public:
-    Return(Location *val);
-
-    void EmitSpecific(Mips *mips);
-};
-
-class PushParam : public Instruction {
-    Location *param;
-public:
-    PushParam(Location *param);
-
-    void EmitSpecific(Mips *mips);
-};
-
-class PopParams : public Instruction {
-    int numBytes;
-public:
-    PopParams(int numBytesOfParamsToRemove);
-
-    void EmitSpecific(Mips *mips);
-};
-
-class LCall : public Instruction {
-    const char *label;
-    Location *dst;
-public:
-    LCall(const char *labe, Location *result);
-
-    void EmitSpecific(Mips *mips);
-};
-
-class ACall : public Instruction {
-    Location *dst, *methodAddr;
-public:
-    ACall(Location *meth, Location *result);
-
-    void EmitSpecific(Mips *mips);
-};
-
-class VTable : public Instruction {
-    List<const char *> *methodLabels;
-    const char *label;
-public:
-    VTable(const char *labelForTable, List<const char *> *methodLabels);
-
-    void EmitSpecific(Mips *mips);
+    // Computes a op b as the MIPS instruction would; false for a
+    // division that would trap.
+    static bool Fold(OpCode code, int a, int b, int &result);
 };
 
 
@@ -378,7 +279,12 @@ private:
         bool isGeneralPurpose;
     } regs[NumRegs];
 
-    Register rs, rt, rd;
+    int next_spill;
+    std::vector<signed char> home;
+    std::vector<Location *> homed;
+    std::vector<Location *> entry_loads;
+    unsigned int saved_homes;
+    int saved_offset;
 
     typedef enum {
         ForRead, ForWrite
@@ -388,17 +294,43 @@ private:
 
     void SpillRegister(Location *dst, Register reg);
 
+    // Values stay cached in $t0-$t9 within a basic block. A register is
+    // written back only when it is needed for something else or at a
+    // block end or call; globals must also reach memory before a return.
+    bool FindHome(Location *var, Register &reg);
+
+    Register GetRegister(Location *var, Reason reason = ForRead,
+                         Register avoid1 = zero, Register avoid2 = zero);
+
+    bool FindRegisterWithContents(Location *var, Register &reg);
+
+    Register SelectRegisterToSpill(Register avoid1, Register avoid2);
+
+    void SpillDirtyRegisters(bool globalsOnly = false);
+
+    void DiscardRegisters();
+
     void EmitCallInstr(Location *dst, const char *fn, bool isL);
 
     static const char *mipsName[BinaryOp::NumOps];
 
     static const char *NameForTac(BinaryOp::OpCode code);
 
-    Instruction *currentInstruction;
+    static Register HomeRegister(int home);
 
 public:
+    // Registers the allocator may hand out: $t3-$t9, which calls
+    // clobber, then $s0-$s7, which a function saves if it uses them.
+    static const int NumTempHomes = 7, NumSavedHomes = 8;
+
     Mips();
 
+    // Keeps var in home register for the whole of the next function,
+    // loading it from its slot after the prologue if load is set.
+    void SetHome(Location *var, int home, bool load);
+
+    void ClearHomes();
+
     static void Emit(const char *fmt, ...);
 
     void EmitLoadConstant(Location *dst, int val);
@@ -420,7 +352,7 @@ public:
 
     void EmitGoto(const char *label);
 
-    void EmitIfZ(Location *test, const char *label);
+    void EmitIfZ(Location *test, const char *label, bool testDies = false);
 
     void EmitReturn(Location *returnVal);
 
@@ -440,23 +372,11 @@ public:
 
     void EmitPreamble();
 
-    class CurrentInstruction;
+    // Forgets var's register without writing it back; for values no
+    // later instruction reads.
+    void DiscardValue(Location *var);
 };
 
 
-class Mips::CurrentInstruction {
-public:
-    CurrentInstruction(Mips &mips, Instruction *instr) : mips(mips) {
-        mips.currentInstruction = instr;
-    }
-
-    ~CurrentInstruction() {
-        mips.currentInstruction = NULL;
-    }
-
-private:
-    Mips &mips;
-};
-
 #endif
 
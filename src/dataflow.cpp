@@ -0,0 +1,291 @@
+#include <algorithm>
+#include "dataflow.h"
+
+
+Variables::Variables(CodeGenerator *c, CFG *g) : cg(c), cfg(g) {
+    const std::vector<TacInstr> &code = cfg->GetFunction()->code;
+    int n = code.size();
+
+    for (int i = 0; i < n; i++) {
+        const TacInstr &ins = code[i];
+        if (ins.dst >= 0) operand.push_back(ins.dst);
+        if (ins.src1 >= 0) operand.push_back(ins.src1);
+        if (ins.op == TacBinaryOp) operand.push_back(ins.src2);
+    }
+    std::sort(operand.begin(), operand.end());
+    operand.erase(std::unique(operand.begin(), operand.end()), operand.end());
+
+    defs.assign(n, -1);
+    uses.assign(2 * n, -1);
+    for (int i = 0; i < n; i++) {
+        const TacInstr &ins = code[i];
+        int v[3] = {-1, -1, -1};
+        int ids[3] = {ins.dst, ins.src1,
+                      ins.op == TacBinaryOp ? ins.src2 : -1};
+        for (int k = 0; k < 3; k++)
+            if (ids[k] >= 0)
+                v[k] = std::lower_bound(operand.begin(), operand.end(), ids[k])
+                       - operand.begin();
+        switch (ins.op) {
+            case TacStore:
+                uses[2 * i] = v[0];
+                uses[2 * i + 1] = v[1];
+                break;
+            case TacBinaryOp:
+                defs[i] = v[0];
+                uses[2 * i] = v[1];
+                uses[2 * i + 1] = v[2];
+                break;
+            default:
+                defs[i] = v[0];
+                uses[2 * i] = v[1];
+                break;
+        }
+    }
+
+    // a variable needs a bit if some block reads it before writing it
+    int nv = operand.size();
+    std::vector<int> written(nv, -1);
+    bit.assign(nv, -1);
+    for (int b = 0; b < cfg->NumBlocks(); b++) {
+        BasicBlock *bb = cfg->Block(b);
+        for (int i = bb->first; i < bb->end; i++) {
+            for (int k = 0; k < 2; k++) {
+                int u = uses[2 * i + k];
+                if (u >= 0 && written[u] != b && bit[u] < 0) {
+                    bit[u] = var_of_bit.size();
+                    var_of_bit.push_back(u);
+                }
+            }
+            if (defs[i] >= 0) written[defs[i]] = b;
+        }
+    }
+    for (int v = 0; v < nv; v++) {
+        if (IsGlobal(v) && bit[v] < 0) {
+            bit[v] = var_of_bit.size();
+            var_of_bit.push_back(v);
+        }
+    }
+    for (int v = 0; v < nv; v++)
+        if (IsGlobal(v)) global_bits.Set(bit[v]);
+}
+
+bool Variables::IsGlobal(int v) const {
+    return GetLocation(v)->GetSegment() == gpRelative;
+}
+
+bool Variables::IsTracked(const Location *l) {
+    return l->GetSegment() == fpRelative && l->GetBase() == NULL;
+}
+
+void Variables::FindDeadValues(std::vector<unsigned char> &dead) const {
+    int nv = NumVars();
+    std::vector<int> seen(nv, -1);
+    std::vector<bool> live(nv);
+    std::vector<int> globals;
+
+    for (int v = 0; v < nv; v++)
+        if (IsGlobal(v)) globals.push_back(v);
+    dead.assign(defs.size(), 0);
+    for (int b = 0; b < cfg->NumBlocks(); b++) {
+        BasicBlock *bb = cfg->Block(b);
+        for (int i = bb->end - 1; i >= bb->first; i--) {
+            int d = defs[i];
+            for (int k = -1; k < 2; k++) {
+                int v = k < 0 ? d : uses[2 * i + k];
+                if (v >= 0 && seen[v] != b) {
+                    seen[v] = b;
+                    live[v] = bit[v] >= 0;
+                }
+            }
+            if (d >= 0 && !live[d]) dead[i] |= 1;
+            for (int k = 0; k < 2; k++) {
+                int u = uses[2 * i + k];
+                if (u >= 0 && u != d && !live[u]) dead[i] |= 2 << k;
+            }
+            if (d >= 0) live[d] = false;
+            for (int k = 0; k < 2; k++)
+                if (uses[2 * i + k] >= 0) live[uses[2 * i + k]] = true;
+            if (ReadsGlobals(i))
+                for (size_t g = 0; g < globals.size(); g++) {
+                    seen[globals[g]] = b;
+                    live[globals[g]] = true;
+                }
+        }
+    }
+}
+
+bool Variables::ReadsGlobals(int instr) const {
+    int op = cfg->GetFunction()->code[instr].op;
+    return op == TacLCall || op == TacACall || op == TacReturn
+           || op == TacEndFunc;
+}
+
+
+Dataflow::Dataflow(CFG *g, bool fwd, bool meetUnion)
+        : cfg(g), forward(fwd), meet_union(meetUnion), visits(0) {
+    int n = cfg->NumBlocks();
+    gen.resize(n);
+    kill.resize(n);
+    in.resize(n);
+    out.resize(n);
+}
+
+void Dataflow::Solve() {
+    std::vector<int> order(cfg->ReversePostorder());
+    int n = order.size();
+    std::vector<bool> queued(cfg->NumBlocks(), false);
+    std::vector<bool> visited(cfg->NumBlocks(), false);
+    std::vector<int> work;
+    SparseBitSet meet;
+
+    if (!forward) std::reverse(order.begin(), order.end());
+
+    // pop from the back, so push in reverse to visit in order first
+    for (int i = n - 1; i >= 0; i--) {
+        work.push_back(order[i]);
+        queued[order[i]] = true;
+    }
+    while (!work.empty()) {
+        int b = work.back();
+        work.pop_back();
+        queued[b] = false;
+        visits++;
+
+        BasicBlock *bb = cfg->Block(b);
+        const std::vector<int> &from = forward ? bb->preds : bb->succs;
+        const std::vector<SparseBitSet> &src = forward ? out : in;
+        bool first = true;
+        meet.ClearAll();
+        for (size_t i = 0; i < from.size(); i++) {
+            int p = from[i];
+            if (!cfg->IsReachable(p) || (!meet_union && !visited[p]))
+                continue;
+            if (meet_union || first) meet.UnionWith(src[p]);
+            else meet.IntersectWith(src[p]);
+            first = false;
+        }
+        (forward ? in : out)[b] = meet;
+
+        // result = gen | (meet & ~kill)
+        SparseBitSet &result = forward ? out[b] : in[b];
+        SparseBitSet r = meet;
+        r.Subtract(kill[b]);
+        r.UnionWith(gen[b]);
+        Restrict(b, r);
+        bool changed = !(r == result);
+        if (changed) result.Swap(r);
+        if (visited[b] && !changed) continue;
+        visited[b] = true;
+
+        const std::vector<int> &to = forward ? bb->succs : bb->preds;
+        for (size_t i = 0; i < to.size(); i++) {
+            if (queued[to[i]] || !cfg->IsReachable(to[i])) continue;
+            queued[to[i]] = true;
+            work.push_back(to[i]);
+        }
+    }
+}
+
+
+Liveness::Liveness(Variables *v)
+        : Dataflow(v->GetCFG(), false, true), vars(v) {
+    for (int b = 0; b < cfg->NumBlocks(); b++) {
+        BasicBlock *bb = cfg->Block(b);
+        for (int i = bb->end - 1; i >= bb->first; i--) {
+            int d = vars->Def(i);
+            if (d >= 0 && vars->Bit(d) >= 0) {
+                kill[b].Set(vars->Bit(d));
+                gen[b].Clear(vars->Bit(d));
+            }
+            for (int k = 0; k < 2; k++) {
+                int u = vars->Use(i, k);
+                if (u >= 0 && vars->Bit(u) >= 0) gen[b].Set(vars->Bit(u));
+            }
+            if (vars->ReadsGlobals(i)) gen[b].UnionWith(vars->GlobalBits());
+        }
+    }
+    Solve();
+}
+
+void Liveness::LiveAfter(int instr, SparseBitSet &live) const {
+    BasicBlock *bb = cfg->Block(cfg->BlockOf(instr));
+    live = out[bb->id];
+    for (int i = bb->end - 1; i > instr; i--) {
+        int d = vars->Def(i);
+        if (d >= 0 && vars->Bit(d) >= 0) live.Clear(vars->Bit(d));
+        for (int k = 0; k < 2; k++) {
+            int u = vars->Use(i, k);
+            if (u >= 0 && vars->Bit(u) >= 0) live.Set(vars->Bit(u));
+        }
+        if (vars->ReadsGlobals(i)) live.UnionWith(vars->GlobalBits());
+    }
+}
+
+
+ReachingDefs::ReachingDefs(Variables *v, const Liveness *l)
+        : Dataflow(v->GetCFG(), true, true), vars(v), live(l) {
+    int n = cfg->GetFunction()->code.size();
+    int nb = vars->NumBits();
+
+    // Sites are numbered so each variable's are contiguous; killing a
+    // variable or dropping it when dead is then a range operation.
+    site_of_instr.assign(n, -1);
+    var_sites_start.assign(nb + 1, 0);
+    for (int i = 0; i < n; i++) {
+        int d = vars->Def(i);
+        if (d < 0 || vars->Bit(d) < 0 || vars->IsGlobal(d)) continue;
+        var_sites_start[vars->Bit(d) + 1]++;
+    }
+    for (int b = 0; b < nb; b++)
+        var_sites_start[b + 1] += var_sites_start[b];
+    instr_of_site.resize(var_sites_start[nb]);
+    var_of_site.resize(var_sites_start[nb]);
+    std::vector<int> fill(var_sites_start.begin(), var_sites_start.end() - 1);
+    for (int i = 0; i < n; i++) {
+        int d = vars->Def(i);
+        if (d < 0 || vars->Bit(d) < 0 || vars->IsGlobal(d)) continue;
+        int s = fill[vars->Bit(d)]++;
+        site_of_instr[i] = s;
+        instr_of_site[s] = i;
+        var_of_site[s] = vars->Bit(d);
+    }
+
+    std::vector<int> seen(nb, -1);
+    for (int b = 0; b < cfg->NumBlocks(); b++) {
+        // only the last site of each variable in the block survives it
+        BasicBlock *bb = cfg->Block(b);
+        for (int i = bb->end - 1; i >= bb->first; i--) {
+            int s = site_of_instr[i];
+            if (s < 0) continue;
+            int var = var_of_site[s];
+            if (seen[var] == b) continue;
+            seen[var] = b;
+            kill[b].SetRange(var_sites_start[var], var_sites_start[var + 1]);
+            gen[b].Set(s);
+        }
+    }
+    Solve();
+}
+
+void ReachingDefs::Restrict(int b, SparseBitSet &set) {
+    const SparseBitSet &liveOut = live->Out(b);
+    for (int s = set.NextSet(0); s >= 0;) {
+        int var = var_of_site[s];
+        int end = var_sites_start[var + 1];
+        if (!liveOut.Test(var)) set.ClearRange(s, end);
+        s = set.NextSet(end);
+    }
+}
+
+void ReachingDefs::ReachingAt(int instr, SparseBitSet &reach) const {
+    BasicBlock *bb = cfg->Block(cfg->BlockOf(instr));
+    reach = in[bb->id];
+    for (int i = bb->first; i < instr; i++) {
+        int s = site_of_instr[i];
+        if (s < 0) continue;
+        int var = var_of_site[s];
+        reach.ClearRange(var_sites_start[var], var_sites_start[var + 1]);
+        reach.Set(s);
+    }
+}
@@ -0,0 +1,139 @@
+#ifndef _H_dataflow
+#define _H_dataflow
+
+#include <vector>
+#include "codegen.h"
+#include "cfg.h"
+#include "ds.h"
+
+
+// Dense numbering of the Locations a function's TAC mentions, with the
+// def and uses of every instruction. Only variables that are read in some
+// block before being written there (plus globals, which calls and
+// returns read) can be live across blocks; just those get dataflow bits,
+// so block-local temps cost nothing in the bitsets.
+class Variables {
+private:
+    CodeGenerator *cg;
+    CFG *cfg;
+    std::vector<int> operand;
+    std::vector<int> defs;
+    std::vector<int> uses;
+    std::vector<int> bit;
+    std::vector<int> var_of_bit;
+    SparseBitSet global_bits;
+
+public:
+    Variables(CodeGenerator *cg, CFG *cfg);
+
+    CFG *GetCFG() const { return cfg; }
+
+    int NumVars() const { return operand.size(); }
+
+    Location *GetLocation(int v) const { return cg->GetOperand(operand[v]); }
+
+    bool IsGlobal(int v) const;
+
+    // An fp-relative local, parameter or temp, reached without a base
+    // pointer. Only these are register candidates and can be followed
+    // through the code; a global may change under any call.
+    static bool IsTracked(const Location *l);
+
+    bool IsTracked(int v) const { return IsTracked(GetLocation(v)); }
+
+    int Def(int instr) const { return defs[instr]; }
+
+    int Use(int instr, int k) const { return uses[2 * instr + k]; }
+
+    // Calls, returns and EndFunc may read every global.
+    bool ReadsGlobals(int instr) const;
+
+    int NumBits() const { return var_of_bit.size(); }
+
+    int Bit(int v) const { return bit[v]; }
+
+    int VarOfBit(int b) const { return var_of_bit[b]; }
+
+    const SparseBitSet &GlobalBits() const { return global_bits; }
+
+    // Marks, per instruction, the def (bit 0) and uses (bits 1 and 2)
+    // whose value nothing later reads, without solving liveness: every
+    // variable with a bit is taken to be live at the end of each block.
+    void FindDeadValues(std::vector<unsigned char> &dead) const;
+};
+
+
+// Iterative worklist solver for gen/kill problems over a CFG's reachable
+// blocks. Forward problems meet over predecessors' Out, backward ones
+// over successors' In; the meet is union or intersection. For
+// intersection, blocks not yet visited count as the full set.
+class Dataflow {
+protected:
+    CFG *cfg;
+    bool forward;
+    bool meet_union;
+    std::vector<SparseBitSet> gen, kill, in, out;
+    int visits;
+
+    Dataflow(CFG *cfg, bool forward, bool meetUnion);
+
+    virtual ~Dataflow() {}
+
+    // Lets a problem drop facts from a block's result before it is
+    // compared and propagated.
+    virtual void Restrict(int b, SparseBitSet &set) {}
+
+    void Solve();
+
+public:
+    const SparseBitSet &In(int b) const { return in[b]; }
+
+    const SparseBitSet &Out(int b) const { return out[b]; }
+
+    int NumVisits() const { return visits; }
+};
+
+
+// Bits are Variables bits.
+class Liveness : public Dataflow {
+private:
+    Variables *vars;
+
+public:
+    Liveness(Variables *vars);
+
+    // Variables (by bit) live just after instruction instr.
+    void LiveAfter(int instr, SparseBitSet &live) const;
+};
+
+
+// Bits are definition sites: instructions that write a variable with a
+// dataflow bit. Globals are left out since any call may write them. A
+// site is dropped at the end of any block where its variable is dead, so
+// sets hold only definitions some later use can see; otherwise every
+// single-assignment temp would reach the rest of the function.
+class ReachingDefs : public Dataflow {
+private:
+    Variables *vars;
+    const Liveness *live;
+    std::vector<int> site_of_instr;
+    std::vector<int> instr_of_site;
+    std::vector<int> var_of_site;
+    std::vector<int> var_sites_start;
+
+public:
+    ReachingDefs(Variables *vars, const Liveness *live);
+
+    void Restrict(int b, SparseBitSet &set);
+
+    int NumSites() const { return instr_of_site.size(); }
+
+    int SiteOf(int instr) const { return site_of_instr[instr]; }
+
+    int InstrOfSite(int site) const { return instr_of_site[site]; }
+
+    // Definition sites reaching the point just before instruction instr.
+    void ReachingAt(int instr, SparseBitSet &reach) const;
+};
+
+#endif
@@ -0,0 +1,206 @@
+#include <algorithm>
+#include "dce.h"
+
+
+// The operand field holding use k, in the order Variables numbers them.
+static int &UseOperand(TacInstr &ins, int k) {
+    if (ins.op == TacStore) return k == 0 ? ins.dst : ins.src1;
+    return k == 0 ? ins.src1 : ins.src2;
+}
+
+CopyPropagator::CopyPropagator(CFG *g, Variables *v)
+        : cfg(g), vars(v), replaced(0) {
+    int n = vars->NumVars();
+    copy_of.assign(n, -1);
+    copy_version.assign(n, 0);
+    copy_block.assign(n, -1);
+    version.assign(n, 0);
+}
+
+int CopyPropagator::CopySource(int v, int b) const {
+    if (copy_block[v] != b) return -1;
+    int s = copy_of[v];
+    return version[s] == copy_version[v] ? s : -1;
+}
+
+bool CopyPropagator::Run() {
+    std::vector<TacInstr> &code = cfg->GetFunction()->code;
+
+    for (int b = 0; b < cfg->NumBlocks(); b++) {
+        BasicBlock *bb = cfg->Block(b);
+        for (int i = bb->first; i < bb->end; i++) {
+            TacInstr &ins = code[i];
+            int src = -1;
+            for (int k = 0; k < 2; k++) {
+                int u = vars->Use(i, k);
+                if (u < 0) continue;
+                int s = CopySource(u, b);
+                if (s >= 0) {
+                    UseOperand(ins, k) = vars->GetLocation(s)->GetId();
+                    replaced++;
+                    u = s;
+                }
+                if (k == 0) src = u;
+            }
+            int d = vars->Def(i);
+            if (d < 0) continue;
+            version[d]++;
+            copy_block[d] = -1;
+            if (ins.op == TacAssign && src >= 0 && src != d
+                && vars->IsTracked(d)
+                && vars->IsTracked(src)) {
+                copy_of[d] = src;
+                copy_version[d] = version[src];
+                copy_block[d] = b;
+            }
+        }
+    }
+    return replaced > 0;
+}
+
+
+DeadCodeEliminator::DeadCodeEliminator(CodeGenerator *c, TacFunction *f)
+        : cg(c), fn(f), removed(0), merged(0), bytes_saved(0) {}
+
+static bool HasNoSideEffect(const TacInstr &ins) {
+    switch (ins.op) {
+        case TacLoadConstant:
+        case TacLoadStringLiteral:
+        case TacLoadLabel:
+        case TacAssign:
+        case TacLoad:
+            return true;
+        case TacBinaryOp:
+            return ins.code != BinaryOp::Div && ins.code != BinaryOp::Mod;
+        default:
+            return false;
+    }
+}
+
+static bool CanRetarget(const TacInstr &ins) {
+    return HasNoSideEffect(ins) || ins.op == TacBinaryOp
+           || ins.op == TacLCall || ins.op == TacACall;
+}
+
+bool DeadCodeEliminator::RunOnce() {
+    std::vector<TacInstr> &code = fn->code;
+    CFG cfg(cg, fn);
+    Variables vars(cg, &cfg);
+    Liveness live(&vars);
+    int nv = vars.NumVars();
+    std::vector<int> seen(nv, -1);
+    std::vector<bool> alive(nv);
+    std::vector<bool> drop(code.size(), false);
+    bool changed = false;
+
+    for (int b = 0; b < cfg.NumBlocks(); b++) {
+        BasicBlock *bb = cfg.Block(b);
+        const SparseBitSet &out = live.Out(b);
+        int retarget = -1;
+        for (int i = bb->end - 1; i >= bb->first; i--) {
+            TacInstr &ins = code[i];
+            int d = retarget >= 0 ? retarget : vars.Def(i);
+            retarget = -1;
+            for (int k = -1; k < 2; k++) {
+                int v = k < 0 ? d : vars.Use(i, k);
+                if (v >= 0 && seen[v] != b) {
+                    seen[v] = b;
+                    alive[v] = vars.Bit(v) >= 0 && out.Test(vars.Bit(v));
+                }
+            }
+            if (d >= 0 && !alive[d] && vars.IsTracked(d)) {
+                if (HasNoSideEffect(ins)) {
+                    drop[i] = true;
+                    removed++;
+                    continue;
+                }
+                if (ins.op == TacLCall || ins.op == TacACall) {
+                    ins.dst = -1;
+                    d = -1;
+                    changed = true;
+                }
+            }
+            if (ins.op == TacAssign && ins.src1 == ins.dst) {
+                drop[i] = true;
+                removed++;
+                continue;
+            }
+            // t = ...; x = t where t dies here: write x directly
+            int t = vars.Use(i, 0);
+            if (ins.op == TacAssign && i > bb->first && t != d && !alive[t]
+                && vars.Def(i - 1) == t && CanRetarget(code[i - 1])
+                && vars.IsTracked(t)) {
+                code[i - 1].dst = ins.dst;
+                retarget = d;
+                drop[i] = true;
+                merged++;
+                continue;
+            }
+            if (d >= 0) alive[d] = false;
+            for (int k = 0; k < 2; k++)
+                if (vars.Use(i, k) >= 0) alive[vars.Use(i, k)] = true;
+        }
+    }
+
+    std::vector<TacInstr> result;
+    result.reserve(code.size());
+    for (size_t i = 0; i < code.size(); i++)
+        if (!drop[i]) result.push_back(code[i]);
+    if (result.size() == code.size()) return changed;
+    code.swap(result);
+    return true;
+}
+
+// Locals and temps keep their order but close up the slots of those no
+// longer referenced. Parameters, at positive offsets, are left alone.
+void DeadCodeEliminator::CompactFrame() {
+    std::vector<TacInstr> &code = fn->code;
+    std::vector<int> ids;
+
+    for (size_t i = 0; i < code.size(); i++) {
+        const TacInstr &ins = code[i];
+        int ops[3] = {ins.dst, ins.src1,
+                      ins.op == TacBinaryOp ? ins.src2 : -1};
+        for (int k = 0; k < 3; k++) {
+            if (ops[k] < 0) continue;
+            Location *l = cg->GetOperand(ops[k]);
+            if (l->GetSegment() == fpRelative
+                && l->GetOffset() <= CodeGenerator::OffsetToFirstLocal)
+                ids.push_back(ops[k]);
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    std::vector<int> offsets;
+    for (size_t i = 0; i < ids.size(); i++)
+        offsets.push_back(cg->GetOperand(ids[i])->GetOffset());
+    std::sort(offsets.begin(), offsets.end());
+    offsets.erase(std::unique(offsets.begin(), offsets.end()),
+                  offsets.end());
+
+    // offsets are ascending, so the slot nearest fp is last
+    int n = offsets.size();
+    for (size_t i = 0; i < ids.size(); i++) {
+        Location *l = cg->GetOperand(ids[i]);
+        int rank = std::lower_bound(offsets.begin(), offsets.end(),
+                                    l->GetOffset()) - offsets.begin();
+        l->SetOffset(CodeGenerator::OffsetToFirstLocal
+                     - (n - 1 - rank) * CodeGenerator::VarSize);
+    }
+
+    TacInstr &begin = code[1];
+    int size = n * CodeGenerator::VarSize;
+    if (size < begin.imm) {
+        bytes_saved += begin.imm - size;
+        begin.imm = size;
+    }
+}
+
+bool DeadCodeEliminator::Run() {
+    bool changed = false;
+    while (RunOnce()) changed = true;
+    int saved = bytes_saved;
+    CompactFrame();
+    return changed || bytes_saved != saved;
+}
@@ -0,0 +1,64 @@
+#ifndef _H_dce
+#define _H_dce
+
+#include <vector>
+#include "codegen.h"
+#include "cfg.h"
+#include "dataflow.h"
+
+
+// Forward copy propagation within each block: after x = y, later reads
+// of x read y instead, until either is written again. Only locals and
+// temps take part; a global may change under any call.
+class CopyPropagator {
+private:
+    CFG *cfg;
+    Variables *vars;
+    std::vector<int> copy_of;
+    std::vector<int> copy_version;
+    std::vector<int> copy_block;
+    std::vector<int> version;
+    int replaced;
+
+    int CopySource(int var, int b) const;
+
+public:
+    CopyPropagator(CFG *cfg, Variables *vars);
+
+    // Returns whether the code changed.
+    bool Run();
+
+    int NumReplaced() const { return replaced; }
+};
+
+
+// Deletes instructions whose result no later instruction reads, by
+// global liveness, and repeats until nothing more dies. Calls and stores
+// stay (a call just loses its dead result), and so do Div and Mod, which
+// may trap. A temp computed only to be copied into x is computed into x
+// directly. Afterwards the surviving locals and temps are packed into a
+// smaller frame.
+class DeadCodeEliminator {
+private:
+    CodeGenerator *cg;
+    TacFunction *fn;
+    int removed, merged, bytes_saved;
+
+    bool RunOnce();
+
+    void CompactFrame();
+
+public:
+    DeadCodeEliminator(CodeGenerator *cg, TacFunction *fn);
+
+    // Returns whether the code changed.
+    bool Run();
+
+    int NumRemoved() const { return removed; }
+
+    int NumMerged() const { return merged; }
+
+    int NumBytesSaved() const { return bytes_saved; }
+};
+
+#endif
@@ -1,68 +1,339 @@
 
 
 
+template<class Value>
+unsigned int Hashtable<Value>::Hash(const char *key) {
+    unsigned long p = (unsigned long) key;
+    return (unsigned int) ((p ^ (p >> 29)) * 0x9E3779B97F4A7C15ul >> 32);
+}
+
+
+template<class Value>
+Hashtable<Value>::Hashtable() : slots(16, EmptySlot) {
+    numEntries = 0;
+    numUsedSlots = 0;
+}
+
+
+template<class Value>
+int Hashtable<Value>::FindSlot(const char *key, unsigned int hash) const {
+    int mask = slots.size() - 1;
+    int tomb = -1;
+    for (int i = hash & mask;; i = (i + 1) & mask) {
+        int e = slots[i];
+        if (e == EmptySlot)
+            return tomb != -1 ? tomb : i;
+        if (e == DeletedSlot) {
+            if (tomb == -1) tomb = i;
+        } else if (entries[e].key == key) {
+            return i;
+        }
+    }
+}
+
+
+// Drops removed entries, keeping the rest in insertion order, and
+// rebuilds the slot array at a size set by the live entries alone, so
+// tombstones left by scope exits do not pile up.
+template<class Value>
+void Hashtable<Value>::Rehash() {
+    std::vector<int> renumber(entries.size(), EmptySlot);
+    int n = 0;
+    for (int i = 0; i < entries.size(); i++) {
+        if (!entries[i].live) continue;
+        renumber[i] = n;
+        entries[n++] = entries[i];
+    }
+    entries.resize(n);
+    for (int i = 0; i < n; i++)
+        if (entries[i].shadowed >= 0)
+            entries[i].shadowed = renumber[entries[i].shadowed];
+
+    int size = 16;
+    while (size < 2 * (numEntries + 1))
+        size *= 2;
+    std::vector<int> old;
+    old.swap(slots);
+    slots.assign(size, EmptySlot);
+    int mask = size - 1;
+    numUsedSlots = 0;
+    for (int i = 0; i < old.size(); i++) {
+        if (old[i] < 0) continue;
+        int e = renumber[old[i]];
+        int j = entries[e].hash & mask;
+        while (slots[j] != EmptySlot)
+            j = (j + 1) & mask;
+        slots[j] = e;
+        numUsedSlots++;
+    }
+}
+
+
 template<class Value>
 void Hashtable<Value>::Enter(const char *key,
                              Value val, bool overwrite) {
-    Value prev;
-    if (overwrite && (prev = Lookup(key)))
-        Remove(key, prev);
-    mmap.insert(std::make_pair(strdup(key), val));
+    assert(key == Intern(key));
+    if ((numUsedSlots + 1) * 4 > slots.size() * 3
+        || entries.size() >= 2 * numEntries + 16)
+        Rehash();
+
+    unsigned int hash = Hash(key);
+    int slot = FindSlot(key, hash);
+    int head = slots[slot];
+
+    if (head >= 0 && overwrite) {
+        entries[head].value = val;
+        return;
+    }
+
+    Entry e;
+    e.key = key;
+    e.hash = hash;
+    e.value = val;
+    e.shadowed = head >= 0 ? head : EmptySlot;
+    e.live = true;
+    entries.push_back(e);
+
+    if (head == EmptySlot) numUsedSlots++;
+    slots[slot] = entries.size() - 1;
+    numEntries++;
 }
 
 
 template<class Value>
 void Hashtable<Value>::Remove(const char *key,
                               Value val) {
-    if (mmap.count(key) == 0)
-        return;
+    assert(key == Intern(key));
+    int slot = FindSlot(key, Hash(key));
+    int *link = &slots[slot];
+
+    // shadow chains end in EmptySlot, so unlinking the last entry for a key
+    // leaves its slot empty and it only needs to become a tombstone
 
-    typename std::multimap<const char *, Value>::iterator itr;
-    itr = mmap.find(key);
-    while (itr != mmap.upper_bound(key)) {
-        if (itr->second == val) {
-            mmap.erase(itr);
-            break;
+    while (*link >= 0) {
+        Entry &e = entries[*link];
+        if (e.value == val) {
+            e.live = false;
+            *link = e.shadowed;
+            numEntries--;
+            if (slots[slot] == EmptySlot)
+                slots[slot] = DeletedSlot;
+            return;
         }
-        ++itr;
+        link = &e.shadowed;
     }
 }
 
 
 template<class Value>
 Value Hashtable<Value>::Lookup(const char *key) {
-    Value found = NULL;
-
-    if (mmap.count(key) > 0) {
-        typename std::multimap<const char *, Value>::iterator cur, last, prev;
-        cur = mmap.find(key);
-        last = mmap.upper_bound(key);
-        while (cur != last) {
-            prev = cur;
-            if (++cur == mmap.upper_bound(key)) {
-                found = prev->second;
-                break;
-            }
-        }
-    }
-    return found;
+    assert(key == Intern(key));
+    int e = slots[FindSlot(key, Hash(key))];
+    return e >= 0 ? entries[e].value : NULL;
 }
 
 
 template<class Value>
 int Hashtable<Value>::NumEntries() const {
-    return mmap.size();
+    return numEntries;
 }
 
 
 template<class Value>
 Iterator <Value> Hashtable<Value>::GetIterator() {
-    return Iterator<Value>(mmap);
+    return Iterator<Value>(entries);
 }
 
 
 template<class Value>
 Value Iterator<Value>::GetNextValue() {
-    return (cur == end ? NULL : (*cur++).second);
+    while (cur < entries->size() && !(*entries)[cur].live)
+        cur++;
+    return (cur == entries->size() ? NULL : (*entries)[cur++].value);
+}
+
+
+
+
+inline int SparseBitSet::Find(int index) const {
+    int lo = 0, hi = chunks.size();
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (chunks[mid].index < index) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+
+inline void SparseBitSet::Set(int i) {
+    int index = i / ChunkBits;
+    int pos = (!chunks.empty() && chunks.back().index < index)
+              ? chunks.size() : Find(index);
+    if (pos == (int) chunks.size() || chunks[pos].index != index) {
+        Chunk c;
+        c.index = index;
+        for (int k = 0; k < ChunkWords; k++)
+            c.w[k] = 0;
+        chunks.insert(chunks.begin() + pos, c);
+    }
+    chunks[pos].w[(i % ChunkBits) >> 5] |= 1u << (i & 31);
 }
 
+
+inline void SparseBitSet::Clear(int i) {
+    int index = i / ChunkBits;
+    int pos = Find(index);
+    if (pos == (int) chunks.size() || chunks[pos].index != index) return;
+    Chunk &c = chunks[pos];
+    c.w[(i % ChunkBits) >> 5] &= ~(1u << (i & 31));
+    unsigned int any = 0;
+    for (int k = 0; k < ChunkWords; k++)
+        any |= c.w[k];
+    if (!any) chunks.erase(chunks.begin() + pos);
+}
+
+
+inline bool SparseBitSet::Test(int i) const {
+    int index = i / ChunkBits;
+    int pos = Find(index);
+    return pos < (int) chunks.size() && chunks[pos].index == index
+           && (chunks[pos].w[(i % ChunkBits) >> 5] >> (i & 31)) & 1;
+}
+
+
+inline void SparseBitSet::SetRange(int lo, int hi) {
+    if (lo >= hi) return;
+    int pos = Find(lo / ChunkBits);
+    for (int index = lo / ChunkBits; index <= (hi - 1) / ChunkBits; index++) {
+        if (pos == (int) chunks.size() || chunks[pos].index != index) {
+            Chunk c;
+            c.index = index;
+            for (int k = 0; k < ChunkWords; k++)
+                c.w[k] = 0;
+            chunks.insert(chunks.begin() + pos, c);
+        }
+        Chunk &c = chunks[pos++];
+        int base = index * ChunkBits;
+        for (int k = 0; k < ChunkWords; k++) {
+            int from = base + k * 32, to = from + 32;
+            if (to <= lo || from >= hi) continue;
+            unsigned int mask = ~0u;
+            if (lo > from) mask &= ~0u << (lo - from);
+            if (hi < to) mask &= ~0u >> (to - hi);
+            c.w[k] |= mask;
+        }
+    }
+}
+
+
+inline void SparseBitSet::ClearRange(int lo, int hi) {
+    if (lo >= hi) return;
+    size_t n = Find(lo / ChunkBits), pos = n;
+    for (; pos < chunks.size() && chunks[pos].index <= (hi - 1) / ChunkBits; pos++) {
+        Chunk c = chunks[pos];
+        int base = c.index * ChunkBits;
+        unsigned int any = 0;
+        for (int k = 0; k < ChunkWords; k++) {
+            int from = base + k * 32, to = from + 32;
+            if (to > lo && from < hi) {
+                unsigned int mask = ~0u;
+                if (lo > from) mask &= ~0u << (lo - from);
+                if (hi < to) mask &= ~0u >> (to - hi);
+                c.w[k] &= ~mask;
+            }
+            any |= c.w[k];
+        }
+        if (any) chunks[n++] = c;
+    }
+    if (n != pos) chunks.erase(chunks.begin() + n, chunks.begin() + pos);
+}
+
+
+inline void SparseBitSet::UnionWith(const SparseBitSet &other) {
+    if (other.chunks.empty()) return;
+    std::vector<Chunk> r;
+    r.reserve(chunks.size() + other.chunks.size());
+    size_t i = 0, j = 0;
+    while (i < chunks.size() || j < other.chunks.size()) {
+        if (j == other.chunks.size()
+            || (i < chunks.size() && chunks[i].index < other.chunks[j].index)) {
+            r.push_back(chunks[i++]);
+        } else if (i == chunks.size()
+                   || other.chunks[j].index < chunks[i].index) {
+            r.push_back(other.chunks[j++]);
+        } else {
+            Chunk c = chunks[i++];
+            const Chunk &o = other.chunks[j++];
+            for (int k = 0; k < ChunkWords; k++)
+                c.w[k] |= o.w[k];
+            r.push_back(c);
+        }
+    }
+    chunks.swap(r);
+}
+
+
+inline void SparseBitSet::IntersectWith(const SparseBitSet &other) {
+    size_t n = 0, j = 0;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        while (j < other.chunks.size() && other.chunks[j].index < chunks[i].index)
+            j++;
+        if (j == other.chunks.size() || other.chunks[j].index != chunks[i].index)
+            continue;
+        Chunk c = chunks[i];
+        unsigned int any = 0;
+        for (int k = 0; k < ChunkWords; k++) {
+            c.w[k] &= other.chunks[j].w[k];
+            any |= c.w[k];
+        }
+        if (any) chunks[n++] = c;
+    }
+    chunks.resize(n);
+}
+
+
+inline void SparseBitSet::Subtract(const SparseBitSet &other) {
+    size_t n = 0, j = 0;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        while (j < other.chunks.size() && other.chunks[j].index < chunks[i].index)
+            j++;
+        Chunk c = chunks[i];
+        if (j < other.chunks.size() && other.chunks[j].index == c.index) {
+            unsigned int any = 0;
+            for (int k = 0; k < ChunkWords; k++) {
+                c.w[k] &= ~other.chunks[j].w[k];
+                any |= c.w[k];
+            }
+            if (!any) continue;
+        }
+        chunks[n++] = c;
+    }
+    chunks.resize(n);
+}
+
+
+inline int SparseBitSet::NextSet(int i) const {
+    if (i < 0) i = 0;
+    for (int pos = Find(i / ChunkBits); pos < (int) chunks.size(); pos++) {
+        const Chunk &c = chunks[pos];
+        int from = c.index == i / ChunkBits ? i % ChunkBits : 0;
+        for (int k = from >> 5; k < ChunkWords; k++) {
+            unsigned int bits = c.w[k];
+            if (k == from >> 5) bits &= ~0u << (from & 31);
+            if (bits) return c.index * ChunkBits + k * 32 + __builtin_ctz(bits);
+        }
+    }
+    return -1;
+}
+
+
+inline bool SparseBitSet::operator==(const SparseBitSet &other) const {
+    if (chunks.size() != other.chunks.size()) return false;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        if (chunks[i].index != other.chunks[i].index) return false;
+        for (int k = 0; k < ChunkWords; k++)
+            if (chunks[i].w[k] != other.chunks[i].w[k]) return false;
+    }
+    return true;
+}
@@ -3,26 +3,48 @@
 #ifndef _H_hashtable
 #define _H_hashtable
 
-#include <map>
+#include <vector>
 #include <string.h>
-
-struct ltstr {
-    bool operator()(const char *s1, const char *s2) const { return strcmp(s1, s2) < 0; }
-};
+#include <assert.h>
+#include "intern.h"
 
 
 template<class Value>
 class Iterator;
 
+// Keys must be interned names (see intern.h): they are hashed and
+// compared by address, so a key built in a buffer or taken from a
+// literal without Intern never matches anything. Builds without NDEBUG
+// assert this on every Enter, Remove and Lookup.
 template<class Value>
 class Hashtable {
+    friend class Iterator<Value>;
 
 private:
-    std::multimap<const char *, Value, ltstr> mmap;
+    struct Entry {
+        const char *key;
+        unsigned int hash;
+        Value value;
+        int shadowed;
+        bool live;
+    };
+
+    enum { EmptySlot = -1, DeletedSlot = -2 };
+
+    std::vector<Entry> entries;
+    std::vector<int> slots;
+    int numEntries;
+    int numUsedSlots;
+
+    static unsigned int Hash(const char *key);
+
+    int FindSlot(const char *key, unsigned int hash) const;
+
+    void Rehash();
 
 public:
 
-    Hashtable() {}
+    Hashtable();
 
 
     int NumEntries() const;
@@ -48,10 +70,11 @@ class Iterator {
     friend class Hashtable<Value>;
 
 private:
-    typename std::multimap<const char *, Value, ltstr>::iterator cur, end;
+    const std::vector<typename Hashtable<Value>::Entry> *entries;
+    int cur;
 
-    Iterator(std::multimap<const char *, Value, ltstr> &t)
-            : cur(t.begin()), end(t.end()) {}
+    Iterator(const std::vector<typename Hashtable<Value>::Entry> &e)
+            : entries(&e), cur(0) {}
 
 public:
 
@@ -60,11 +83,9 @@ public:
 };
 
 
-#include "ds.cpp"
-
-
-#include <deque>
+#include <vector>
 #include "globals.h"
+#include "arena.h"
 
 class Node;
 
@@ -72,12 +93,16 @@ template<class Element>
 class List {
 
 private:
-    std::deque <Element> elems;
+    std::vector <Element, ArenaAllocator<Element> > elems;
 
 public:
 
     List() {}
 
+    static void *operator new(size_t size) { return nodeArena.Alloc(size); }
+
+    static void operator delete(void *p) {}
+
 
     int NumElements() const { return elems.size(); }
 
@@ -130,5 +155,102 @@ public:
     }
 };
 
-#endif
 
+class BitSet {
+
+private:
+    std::vector<unsigned int> words;
+
+public:
+
+    BitSet(int n = 0) : words((n + 31) / 32, 0) {}
+
+
+    void Resize(int n) { words.resize((n + 31) / 32, 0); }
+
+
+    void Set(int i) { words[i >> 5] |= 1u << (i & 31); }
+
+
+    bool Test(int i) const {
+        return (i >> 5) < (int) words.size() && (words[i >> 5] >> (i & 31)) & 1;
+    }
+
+
+    void UnionWith(const BitSet &other) {
+        if (other.words.size() > words.size())
+            words.resize(other.words.size(), 0);
+        for (int i = 0; i < (int) other.words.size(); i++)
+            words[i] |= other.words[i];
+    }
+};
+
+
+// Bits grouped in 256-bit chunks; only chunks holding a set bit are
+// stored, in index order. Sets that are large but clustered, like the
+// temps live in one block of a huge function, stay small, and the word
+// loops inside a chunk are fixed-width for the compiler to vectorize.
+class SparseBitSet {
+
+public:
+    enum { ChunkWords = 8, ChunkBits = 256 };
+
+private:
+    struct Chunk {
+        int index;
+        unsigned int w[ChunkWords];
+    };
+
+    std::vector<Chunk> chunks;
+
+    int Find(int index) const;
+
+public:
+
+    void Set(int i);
+
+
+    void Clear(int i);
+
+
+    bool Test(int i) const;
+
+
+    // Sets or clears bits lo .. hi-1.
+    void SetRange(int lo, int hi);
+
+
+    void ClearRange(int lo, int hi);
+
+
+    void ClearAll() { chunks.clear(); }
+
+
+    bool IsEmpty() const { return chunks.empty(); }
+
+
+    int NumChunks() const { return chunks.size(); }
+
+
+    void UnionWith(const SparseBitSet &other);
+
+
+    void IntersectWith(const SparseBitSet &other);
+
+
+    void Subtract(const SparseBitSet &other);
+
+
+    void Swap(SparseBitSet &other) { chunks.swap(other.chunks); }
+
+
+    // Index of the first set bit at or after i, or -1.
+    int NextSet(int i) const;
+
+
+    bool operator==(const SparseBitSet &other) const;
+};
+
+#include "ds.cpp"
+
+#endif
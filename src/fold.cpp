@@ -0,0 +1,163 @@
+#include "fold.h"
+
+
+static void MakeConstant(TacInstr &ins, int c) {
+    ins.op = TacLoadConstant;
+    ins.code = 0;
+    ins.src1 = -1;
+    ins.imm = c;
+}
+
+static void MakeCopy(TacInstr &ins, int src) {
+    ins.op = TacAssign;
+    ins.code = 0;
+    ins.src1 = src;
+    ins.src2 = -1;
+}
+
+ConstantFolder::ConstantFolder(CFG *g, Variables *v)
+        : cfg(g), vars(v), folded(0), simplified(0), branches(0),
+          deleted(0) {
+    value.assign(vars->NumVars(), 0);
+    known_in.assign(vars->NumVars(), -1);
+    drop.assign(cfg->GetFunction()->code.size(), false);
+}
+
+bool ConstantFolder::Known(int i, int k, int b, int &c) const {
+    int v = vars->Use(i, k);
+    if (v < 0 || known_in[v] != b) return false;
+    c = value[v];
+    return true;
+}
+
+void ConstantFolder::Simplify(int i, int b) {
+    TacInstr &ins = cfg->GetFunction()->code[i];
+    int a = 0, c = 0, r = 0;
+    bool ka, kc;
+
+    switch (ins.op) {
+        case TacAssign:
+            if (Known(i, 0, b, a)) {
+                MakeConstant(ins, a);
+                folded++;
+            } else if (ins.src1 == ins.dst) {
+                drop[i] = true;
+                simplified++;
+            }
+            break;
+        case TacBinaryOp:
+            ka = Known(i, 0, b, a);
+            kc = Known(i, 1, b, c);
+            if (ka && kc) {
+                if (BinaryOp::Fold((BinaryOp::OpCode) ins.code, a, c, r)) {
+                    MakeConstant(ins, r);
+                    folded++;
+                }
+                break;
+            }
+            if (ins.src1 == ins.src2) {
+                switch (ins.code) {
+                    case BinaryOp::Sub:
+                    case BinaryOp::Ne:
+                    case BinaryOp::Lt:
+                    case BinaryOp::Gt:
+                        MakeConstant(ins, 0);
+                        simplified++;
+                        break;
+                    case BinaryOp::Eq:
+                    case BinaryOp::Le:
+                    case BinaryOp::Ge:
+                        MakeConstant(ins, 1);
+                        simplified++;
+                        break;
+                    case BinaryOp::And:
+                    case BinaryOp::Or:
+                        MakeCopy(ins, ins.src1);
+                        simplified++;
+                        break;
+                }
+                break;
+            }
+            // And and Or only see bools, so 1 is the identity for And
+            switch (ins.code) {
+                case BinaryOp::Add:
+                case BinaryOp::Or:
+                    if (ka && a == 0) MakeCopy(ins, ins.src2);
+                    else if (kc && c == 0) MakeCopy(ins, ins.src1);
+                    else if (ins.code == BinaryOp::Or && ((ka && a == 1)
+                                                         || (kc && c == 1)))
+                        MakeConstant(ins, 1);
+                    break;
+                case BinaryOp::Sub:
+                    if (kc && c == 0) MakeCopy(ins, ins.src1);
+                    break;
+                case BinaryOp::Mul:
+                case BinaryOp::And:
+                    if ((ka && a == 0) || (kc && c == 0)) MakeConstant(ins, 0);
+                    else if (ka && a == 1) MakeCopy(ins, ins.src2);
+                    else if (kc && c == 1) MakeCopy(ins, ins.src1);
+                    break;
+                case BinaryOp::Div:
+                    if (kc && c == 1) MakeCopy(ins, ins.src1);
+                    break;
+                case BinaryOp::Mod:
+                    if (kc && (c == 1 || c == -1)) MakeConstant(ins, 0);
+                    break;
+            }
+            if (ins.op != TacBinaryOp) simplified++;
+            break;
+        case TacIfZ:
+            if (Known(i, 0, b, a)) {
+                branches++;
+                if (a != 0) drop[i] = true;
+                else ins.op = TacGoto;
+                ins.src1 = -1;
+            }
+            break;
+    }
+}
+
+bool ConstantFolder::Run(CodeGenerator *cg) {
+    std::vector<TacInstr> &code = cfg->GetFunction()->code;
+
+    for (int b = 0; b < cfg->NumBlocks(); b++) {
+        BasicBlock *bb = cfg->Block(b);
+        for (int i = bb->first; i < bb->end; i++) {
+            Simplify(i, b);
+            int d = vars->Def(i);
+            if (d < 0 || !vars->IsTracked(d)) continue;
+            if (code[i].op == TacLoadConstant) {
+                value[d] = code[i].imm;
+                known_in[d] = b;
+            } else if (!drop[i]) {
+                known_in[d] = -1;
+            }
+        }
+    }
+    if (folded + simplified + branches == 0) return false;
+    DeleteDeadConstants(cg);
+    return true;
+}
+
+// The rewrites above leave the code the same length, so the blocks are
+// still right; only the uses need finding again. A LoadConstant into a
+// global always stays: this scan sees one block, and callees may read it.
+void ConstantFolder::DeleteDeadConstants(CodeGenerator *cg) {
+    std::vector<TacInstr> &code = cfg->GetFunction()->code;
+    Variables now(cg, cfg);
+    std::vector<unsigned char> dead;
+    std::vector<TacInstr> result;
+
+    now.FindDeadValues(dead);
+    result.reserve(code.size());
+    for (int i = 0; i < (int) code.size(); i++) {
+        if (drop[i]) continue;
+        if (code[i].op == TacLoadConstant && (dead[i] & 1)
+            && Variables::IsTracked(cg->GetOperand(code[i].dst))) {
+            deleted++;
+            continue;
+        }
+        result.push_back(code[i]);
+    }
+    code.swap(result);
+}
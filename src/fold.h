@@ -0,0 +1,46 @@
+#ifndef _H_fold
+#define _H_fold
+
+#include <vector>
+#include "codegen.h"
+#include "cfg.h"
+#include "dataflow.h"
+
+
+// Constant folding and algebraic simplification within each block.
+// Remembers the constant a local or temp was last given in the block,
+// so copies of it and BinaryOps over it become LoadConstant, identities
+// such as x+0, x*1, x*0 and x-x become a copy or a constant, and an IfZ
+// on a known test becomes a Goto or disappears. LoadConstants whose
+// value is then never read are deleted.
+class ConstantFolder {
+private:
+    CFG *cfg;
+    Variables *vars;
+    std::vector<int> value;
+    std::vector<int> known_in;
+    std::vector<bool> drop;
+    int folded, simplified, branches, deleted;
+
+    bool Known(int instr, int k, int b, int &c) const;
+
+    void Simplify(int instr, int b);
+
+    void DeleteDeadConstants(CodeGenerator *cg);
+
+public:
+    ConstantFolder(CFG *cfg, Variables *vars);
+
+    // Returns whether the code changed.
+    bool Run(CodeGenerator *cg);
+
+    int NumFolded() const { return folded; }
+
+    int NumSimplified() const { return simplified; }
+
+    int NumBranches() const { return branches; }
+
+    int NumDeleted() const { return deleted; }
+};
+
+#endif
@@ -19,4 +19,8 @@ void yyerror(const char *msg) {
 
 int semantic_error = 0;
 int syntax_error = 0;
+bool show_stats = false;
+bool annotate = false;
+bool dump_cfg = false;
+bool dump_tac = false;
 
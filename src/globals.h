@@ -40,6 +40,10 @@ static const char *neg_arr_size = "Array size is <= 0\\n";
 
 extern int syntax_error;
 extern int semantic_error;
+extern bool show_stats;
+extern bool annotate;
+extern bool dump_cfg;
+extern bool dump_tac;
 
 
 typedef struct yyltype {
@@ -0,0 +1,108 @@
+
+
+#include <string.h>
+#include <stdlib.h>
+#include <vector>
+#include "intern.h"
+
+
+class StringPool {
+private:
+    static const int BlockSize = 64 * 1024;
+
+    std::vector<const char *> slots;
+    std::vector<unsigned int> hashes;
+    int numStrings;
+    char *block;
+    int blockLeft;
+
+    static unsigned int Hash(const char *str, int len);
+
+    char *Store(const char *str, int len);
+
+    void Grow();
+
+public:
+    StringPool() : slots(1024, (const char *) NULL), hashes(1024, 0) {
+        numStrings = 0;
+        block = NULL;
+        blockLeft = 0;
+    }
+
+    const char *Intern(const char *str, int len);
+};
+
+
+unsigned int StringPool::Hash(const char *str, int len) {
+    unsigned int h = 2166136261u;
+    for (int i = 0; i < len; i++)
+        h = (h ^ (unsigned char) str[i]) * 16777619u;
+    return h;
+}
+
+
+char *StringPool::Store(const char *str, int len) {
+    char *s;
+    if (len + 1 > BlockSize / 4) {
+        s = (char *) malloc(len + 1);
+    } else {
+        if (len + 1 > blockLeft) {
+            block = (char *) malloc(BlockSize);
+            blockLeft = BlockSize;
+        }
+        s = block;
+        block += len + 1;
+        blockLeft -= len + 1;
+    }
+    memcpy(s, str, len);
+    s[len] = '\0';
+    return s;
+}
+
+
+void StringPool::Grow() {
+    std::vector<const char *> oldSlots(slots.size() * 2, (const char *) NULL);
+    std::vector<unsigned int> oldHashes(hashes.size() * 2, 0);
+    oldSlots.swap(slots);
+    oldHashes.swap(hashes);
+
+    int mask = slots.size() - 1;
+    for (int i = 0; i < oldSlots.size(); i++) {
+        if (!oldSlots[i]) continue;
+        int j = oldHashes[i] & mask;
+        while (slots[j])
+            j = (j + 1) & mask;
+        slots[j] = oldSlots[i];
+        hashes[j] = oldHashes[i];
+    }
+}
+
+
+const char *StringPool::Intern(const char *str, int len) {
+    if ((numStrings + 1) * 2 > slots.size())
+        Grow();
+
+    unsigned int h = Hash(str, len);
+    int mask = slots.size() - 1;
+    int i = h & mask;
+    for (; slots[i]; i = (i + 1) & mask) {
+        if (hashes[i] == h && !strncmp(slots[i], str, len) && !slots[i][len])
+            return slots[i];
+    }
+
+    numStrings++;
+    hashes[i] = h;
+    return slots[i] = Store(str, len);
+}
+
+
+static StringPool *pool;
+
+const char *Intern(const char *str, int len) {
+    if (!pool) pool = new StringPool();
+    return pool->Intern(str, len);
+}
+
+const char *Intern(const char *str) {
+    return Intern(str, strlen(str));
+}
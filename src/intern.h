@@ -0,0 +1,12 @@
+
+
+#ifndef _H_intern
+#define _H_intern
+
+// Returns the canonical copy of str. Equal strings intern to the same
+// pointer, so interned names can be compared with == instead of strcmp.
+const char *Intern(const char *str);
+
+const char *Intern(const char *str, int len);
+
+#endif
@@ -0,0 +1,142 @@
+#include "lvn.h"
+
+
+LocalValueNumbering::LocalValueNumbering(CFG *g, Variables *v)
+        : cfg(g), vars(v), block(-1), call_epoch(0), mem_epoch(0),
+          next_value(0), replaced(0), loads(0) {
+    var_value.assign(vars->NumVars(), -1);
+    var_stamp.assign(vars->NumVars(), -1);
+
+    int size = 16;
+    while (size < 2 * (int) cfg->GetFunction()->code.size()) size *= 2;
+    Entry empty = {-1, 0, 0, 0, 0, -1, -1};
+    table.assign(size, empty);
+}
+
+// Stamps are the block for locals and temps, and the call epoch (which
+// also moves at every block) for globals.
+int LocalValueNumbering::ValueOf(int v) {
+    int stamp = vars->IsGlobal(v) ? call_epoch : block;
+    if (var_stamp[v] != stamp) {
+        var_stamp[v] = stamp;
+        var_value[v] = next_value++;
+    }
+    return var_value[v];
+}
+
+void LocalValueNumbering::SetValue(int v, int value) {
+    var_stamp[v] = vars->IsGlobal(v) ? call_epoch : block;
+    var_value[v] = value;
+}
+
+// Linear probing; entries left from earlier blocks count as empty.
+LocalValueNumbering::Entry &LocalValueNumbering::Find(int op, int a, int b,
+                                                      int c) {
+    unsigned int h = ((op * 31u + a) * 31u + b) * 31u + c;
+    int mask = table.size() - 1;
+    for (int i = (h * 2654435761u) >> 4 & mask;; i = (i + 1) & mask) {
+        Entry &e = table[i];
+        if (e.block != block) {
+            e.block = block;
+            e.op = op;
+            e.a = a;
+            e.b = b;
+            e.c = c;
+            e.value = -1;
+            e.holder = -1;
+            return e;
+        }
+        if (e.op == op && e.a == a && e.b == b && e.c == c) return e;
+    }
+}
+
+static bool IsCommutative(int code) {
+    switch (code) {
+        case BinaryOp::Add:
+        case BinaryOp::Mul:
+        case BinaryOp::Eq:
+        case BinaryOp::Ne:
+        case BinaryOp::And:
+        case BinaryOp::Or:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool LocalValueNumbering::Run() {
+    std::vector<TacInstr> &code = cfg->GetFunction()->code;
+
+    for (int b = 0; b < cfg->NumBlocks(); b++) {
+        BasicBlock *bb = cfg->Block(b);
+        block = b;
+        call_epoch++;
+        for (int i = bb->first; i < bb->end; i++) {
+            TacInstr &ins = code[i];
+            int d = vars->Def(i);
+            Entry *e = NULL;
+            switch (ins.op) {
+                case TacLoadConstant:
+                case TacLoadStringLiteral:
+                case TacLoadLabel:
+                    // an li or la is no dearer than a move, so these stay;
+                    // equal ones still share a value for the ops below
+                    e = &Find(ins.op, ins.imm, 0, 0);
+                    if (e->value < 0) e->value = next_value++;
+                    SetValue(d, e->value);
+                    continue;
+                case TacBinaryOp: {
+                    int x = ValueOf(vars->Use(i, 0));
+                    int y = ValueOf(vars->Use(i, 1));
+                    if (IsCommutative(ins.code) && x > y) {
+                        int t = x;
+                        x = y;
+                        y = t;
+                    }
+                    e = &Find(ins.op, x, y, ins.code);
+                    break;
+                }
+                case TacLoad:
+                    e = &Find(ins.op, ValueOf(vars->Use(i, 0)), ins.imm,
+                              mem_epoch);
+                    break;
+                case TacAssign:
+                    SetValue(d, ValueOf(vars->Use(i, 0)));
+                    continue;
+                case TacStore: {
+                    // the stored value is what a Load from there now reads
+                    int base = ValueOf(vars->Use(i, 0));
+                    mem_epoch++;
+                    Entry &s = Find(TacLoad, base, ins.imm, mem_epoch);
+                    s.value = ValueOf(vars->Use(i, 1));
+                    s.holder = vars->Use(i, 1);
+                    continue;
+                }
+                case TacLCall:
+                case TacACall:
+                    mem_epoch++;
+                    call_epoch++;
+                    break;
+            }
+            if (d < 0) continue;
+            if (e == NULL) {
+                SetValue(d, next_value++);
+                continue;
+            }
+            if (e->holder >= 0 && ValueOf(e->holder) == e->value) {
+                if (ins.op == TacLoad) loads++;
+                replaced++;
+                ins.op = TacAssign;
+                ins.code = 0;
+                ins.src1 = vars->GetLocation(e->holder)->GetId();
+                ins.src2 = -1;
+                SetValue(d, e->value);
+                continue;
+            }
+            if (e->value < 0) e->value = next_value++;
+            e->holder = d;
+            SetValue(d, e->value);
+        }
+    }
+    return replaced > 0;
+}
@@ -0,0 +1,53 @@
+#ifndef _H_lvn
+#define _H_lvn
+
+#include <vector>
+#include "codegen.h"
+#include "cfg.h"
+#include "dataflow.h"
+
+
+// Value numbering within each block. An instruction computing a value
+// some variable still holds (the same BinaryOp over the same values, or
+// a Load from the same address with no Store or call since) becomes a
+// copy of that variable, and a Load just after a Store to its address
+// becomes a copy of the value stored. copyprop and dce then remove the
+// copies. Equal constants, labels and strings share a value but are
+// left in place. Calls give globals new values, since the callee may
+// write them.
+class LocalValueNumbering {
+private:
+    struct Entry {
+        int block;
+        int op, a, b, c;
+        int value;
+        int holder;
+    };
+
+    CFG *cfg;
+    Variables *vars;
+    std::vector<int> var_value;
+    std::vector<int> var_stamp;
+    std::vector<Entry> table;
+    int block, call_epoch, mem_epoch;
+    int next_value;
+    int replaced, loads;
+
+    int ValueOf(int var);
+
+    void SetValue(int var, int value);
+
+    Entry &Find(int op, int a, int b, int c);
+
+public:
+    LocalValueNumbering(CFG *cfg, Variables *vars);
+
+    // Returns whether the code changed.
+    bool Run();
+
+    int NumReplaced() const { return replaced; }
+
+    int NumLoads() const { return loads; }
+};
+
+#endif
@@ -4,11 +4,78 @@
 #include <stdio.h>
 #include "globals.h"
 #include "parser.h"
+#include "arena.h"
+#include "scopeHandler.h"
+#include "output.h"
+#include "optimizer.h"
 
 
+static int Usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-O0|-O1|-O2] [-f<pass>|-fno-<pass>] "
+            "[-o file] [--stats] [--annotate] [--dump-cfg] [--dump-tac] "
+            "[--read-tac] [--stop-after=<pass>] [--time-passes]\n", prog);
+    return 1;
+}
+
 int main(int argc, char *argv[]) {
-    initializeFlex();
-    yyparse();
+    bool readTac = false;
+    for (int i = 1; i < argc; i++)
+        if (!strcmp(argv[i], "--stats"))
+            show_stats = true;
+        else if (!strcmp(argv[i], "--annotate"))
+            annotate = true;
+        else if (!strcmp(argv[i], "--dump-cfg"))
+            dump_cfg = true;
+        else if (!strcmp(argv[i], "--dump-tac"))
+            dump_tac = true;
+        else if (!strcmp(argv[i], "--read-tac"))
+            readTac = true;
+        else if (!strncmp(argv[i], "--stop-after=", 13)) {
+            if (!passManager.StopAfter(argv[i] + 13)) {
+                fprintf(stderr, "unknown pass %s\n", argv[i] + 13);
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "--time-passes"))
+            passManager.SetTiming(true);
+        else if (!strcmp(argv[i], "-O0") || !strcmp(argv[i], "-O1")
+                 || !strcmp(argv[i], "-O2"))
+            passManager.SetLevel(argv[i][2] - '0');
+        else if (!strncmp(argv[i], "-fno-", 5)) {
+            if (!passManager.Force(argv[i] + 5, false)) {
+                fprintf(stderr, "unknown pass %s\n", argv[i] + 5);
+                return 1;
+            }
+        } else if (!strncmp(argv[i], "-f", 2)) {
+            if (!passManager.Force(argv[i] + 2, true)) {
+                fprintf(stderr, "unknown pass %s\n", argv[i] + 2);
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "-o")) {
+            if (i + 1 == argc) {
+                fprintf(stderr, "-o needs a file name\n");
+                return Usage(argv[0]);
+            }
+            if (!asmOut.Open(argv[++i])) {
+                fprintf(stderr, "cannot open %s\n", argv[i]);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return Usage(argv[0]);
+        }
+
+    if (readTac) {
+        if (!CG->ReadTac(stdin)) return 1;
+        passManager.Run(CG);
+        CG->DoFinalCodeGen();
+    } else {
+        initializeFlex();
+        yyparse();
+    }
+    if (show_stats && scopeHandler)
+        fprintf(stderr, "symbol lookups: %d\n", scopeHandler->GetLookupCount());
+    asmOut.Close();
+    nodeArena.FreeAll();
     return 0;
 }
 
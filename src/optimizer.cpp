@@ -0,0 +1,273 @@
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <limits.h>
+#include "optimizer.h"
+#include "globals.h"
+#include "cfg.h"
+#include "dataflow.h"
+#include "ssa.h"
+#include "fold.h"
+#include "dce.h"
+#include "lvn.h"
+#include "regalloc.h"
+
+
+class SCCPPass : public Pass {
+private:
+    int folded, branches, dropped;
+
+public:
+    SCCPPass() : folded(0), branches(0), dropped(0) {}
+
+    const char *GetName() const { return "sccp"; }
+
+    bool Run(CodeGenerator *cg, TacFunction *fn) {
+        CFG cfg(cg, fn);
+        Variables vars(cg, &cfg);
+        Liveness live(&vars);
+        SSAForm ssa(&vars, &live);
+        SCCP prop(&ssa);
+        prop.Run();
+        bool changed = prop.Apply();
+        folded += prop.NumFolded();
+        branches += prop.NumBranches();
+        dropped += prop.NumDropped();
+        return changed;
+    }
+
+    void PrintStats() {
+        fprintf(stderr, "sccp: %d folded, %d branches, %d dropped\n",
+                folded, branches, dropped);
+    }
+};
+
+
+class ConstFoldPass : public Pass {
+private:
+    int folded, simplified, branches, deleted;
+
+public:
+    ConstFoldPass() : folded(0), simplified(0), branches(0), deleted(0) {}
+
+    const char *GetName() const { return "constfold"; }
+
+    bool Run(CodeGenerator *cg, TacFunction *fn) {
+        CFG cfg(cg, fn);
+        Variables vars(cg, &cfg);
+        ConstantFolder folder(&cfg, &vars);
+        bool changed = folder.Run(cg);
+        folded += folder.NumFolded();
+        simplified += folder.NumSimplified();
+        branches += folder.NumBranches();
+        deleted += folder.NumDeleted();
+        return changed;
+    }
+
+    void PrintStats() {
+        fprintf(stderr, "constfold: %d folded, %d simplified, %d branches, "
+                        "%d constants deleted\n",
+                folded, simplified, branches, deleted);
+    }
+};
+
+
+class LVNPass : public Pass {
+private:
+    int replaced, loads;
+
+public:
+    LVNPass() : replaced(0), loads(0) {}
+
+    const char *GetName() const { return "lvn"; }
+
+    bool Run(CodeGenerator *cg, TacFunction *fn) {
+        CFG cfg(cg, fn);
+        Variables vars(cg, &cfg);
+        LocalValueNumbering lvn(&cfg, &vars);
+        bool changed = lvn.Run();
+        replaced += lvn.NumReplaced();
+        loads += lvn.NumLoads();
+        return changed;
+    }
+
+    void PrintStats() {
+        fprintf(stderr, "lvn: %d redundant instructions replaced by copies "
+                        "(%d loads)\n", replaced, loads);
+    }
+};
+
+
+class CopyPropPass : public Pass {
+private:
+    int replaced;
+
+public:
+    CopyPropPass() : replaced(0) {}
+
+    const char *GetName() const { return "copyprop"; }
+
+    bool Run(CodeGenerator *cg, TacFunction *fn) {
+        CFG cfg(cg, fn);
+        Variables vars(cg, &cfg);
+        CopyPropagator prop(&cfg, &vars);
+        bool changed = prop.Run();
+        replaced += prop.NumReplaced();
+        return changed;
+    }
+
+    void PrintStats() {
+        fprintf(stderr, "copyprop: %d uses replaced\n", replaced);
+    }
+};
+
+
+class DCEPass : public Pass {
+private:
+    int removed, merged, bytes;
+
+public:
+    DCEPass() : removed(0), merged(0), bytes(0) {}
+
+    const char *GetName() const { return "dce"; }
+
+    bool Run(CodeGenerator *cg, TacFunction *fn) {
+        DeadCodeEliminator dce(cg, fn);
+        bool changed = dce.Run();
+        removed += dce.NumRemoved();
+        merged += dce.NumMerged();
+        bytes += dce.NumBytesSaved();
+        return changed;
+    }
+
+    void PrintStats() {
+        fprintf(stderr, "dce: %d removed, %d copies merged, "
+                        "%d frame bytes saved\n", removed, merged, bytes);
+    }
+};
+
+
+// Must run last: it records a register for each operand in fn->homes,
+// which any later change to the code would invalidate.
+class RegAllocPass : public Pass {
+private:
+    int allocated, saved, spilled, coalesced;
+
+public:
+    RegAllocPass() : allocated(0), saved(0), spilled(0), coalesced(0) {}
+
+    const char *GetName() const { return "regalloc"; }
+
+    bool Run(CodeGenerator *cg, TacFunction *fn) {
+        CFG cfg(cg, fn);
+        Variables vars(cg, &cfg);
+        Liveness live(&vars);
+        LinearScan scan(&vars, &live);
+
+        fn->homes.clear();
+        for (int v = 0; v < vars.NumVars(); v++) {
+            int reg = scan.RegisterOf(v);
+            if (reg < 0) continue;
+            TacHome h = {vars.GetLocation(v)->GetId(), reg,
+                         scan.LiveOnEntry(v)};
+            fn->homes.push_back(h);
+            allocated++;
+            if (reg >= Mips::NumTempHomes) saved++;
+        }
+        spilled += scan.NumSpilled();
+        coalesced += scan.NumCoalesced();
+        return false;
+    }
+
+    void PrintStats() {
+        fprintf(stderr, "regalloc: %d in registers (%d callee-saved), "
+                        "%d spilled, %d copies coalesced\n",
+                allocated, saved, spilled, coalesced);
+    }
+};
+
+
+PassManager passManager;
+
+static double Now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// The pipeline, in the order passes run, with the lowest -O level that
+// turns each one on. -O1 keeps to passes that look at one block at a
+// time, plus register allocation; -O2 adds the SSA-based ones.
+PassManager::PassManager() : level(0), timing(false), stop_after(INT_MAX) {
+    struct {
+        Pass *pass;
+        int level;
+    } pipeline[] = {
+            {new SCCPPass, 2},
+            {new ConstFoldPass, 1},
+            {new LVNPass, 1},
+            {new CopyPropPass, 1},
+            {new DCEPass, 1},
+            {new RegAllocPass, 1},
+    };
+    for (size_t i = 0; i < sizeof(pipeline) / sizeof(pipeline[0]); i++) {
+        Entry e = {pipeline[i].pass, pipeline[i].level, -1, 0, 0};
+        passes.push_back(e);
+    }
+}
+
+PassManager::~PassManager() {
+    for (size_t i = 0; i < passes.size(); i++)
+        delete passes[i].pass;
+}
+
+bool PassManager::IsEnabled(const Entry &e) const {
+    if (e.forced >= 0) return e.forced;
+    return level >= e.level;
+}
+
+bool PassManager::Force(const char *name, bool on) {
+    for (size_t i = 0; i < passes.size(); i++)
+        if (!strcmp(passes[i].pass->GetName(), name)) {
+            passes[i].forced = on;
+            return true;
+        }
+    return false;
+}
+
+bool PassManager::StopAfter(const char *name) {
+    for (size_t i = 0; i < passes.size(); i++)
+        if (!strcmp(passes[i].pass->GetName(), name)) {
+            stop_after = i;
+            return true;
+        }
+    return false;
+}
+
+void PassManager::Run(CodeGenerator *cg) {
+    // stop_after holds even when that pass is off
+    for (int p = 0; p < (int) passes.size() && p <= stop_after; p++) {
+        Entry &e = passes[p];
+        if (!IsEnabled(e)) continue;
+        double start = timing ? Now() : 0;
+        for (int f = 0; f < cg->NumFunctions(); f++) {
+            TacFunction *fn = cg->GetFunction(f);
+            if (fn->code.size() < 2 || fn->code[1].op != TacBeginFunc)
+                continue;
+            if (e.pass->Run(cg, fn)) e.changed++;
+        }
+        if (timing) e.seconds += Now() - start;
+    }
+    if (show_stats || timing) PrintStats();
+}
+
+void PassManager::PrintStats() {
+    for (int p = 0; p < (int) passes.size() && p <= stop_after; p++) {
+        Entry &e = passes[p];
+        if (!IsEnabled(e)) continue;
+        if (show_stats) e.pass->PrintStats();
+        if (timing)
+            fprintf(stderr, "%-12s %8.3fs  %d functions changed\n",
+                    e.pass->GetName(), e.seconds, e.changed);
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef _H_optimizer
+#define _H_optimizer
+
+#include <vector>
+#include "codegen.h"
+
+
+// A transformation over one function's TAC. Passes are created once and
+// run on every function in turn, so they can keep totals for --stats.
+class Pass {
+public:
+    virtual ~Pass() {}
+
+    virtual const char *GetName() const = 0;
+
+    // Returns whether the code changed.
+    virtual bool Run(CodeGenerator *cg, TacFunction *fn) = 0;
+
+    virtual void PrintStats() {}
+};
+
+
+// Runs the enabled passes, in pipeline order, over every function
+// between TAC generation and Mips lowering. The -O level picks the
+// default set; -f<pass> and -fno-<pass> override it per pass.
+class PassManager {
+private:
+    struct Entry {
+        Pass *pass;
+        int level;
+        int forced;
+        double seconds;
+        int changed;
+    };
+
+    std::vector<Entry> passes;
+    int level;
+    bool timing;
+    int stop_after;
+
+    bool IsEnabled(const Entry &e) const;
+
+public:
+    PassManager();
+
+    ~PassManager();
+
+    void SetLevel(int l) { level = l; }
+
+    void SetTiming(bool on) { timing = on; }
+
+    // Returns false if there is no pass by that name.
+    bool Force(const char *name, bool on);
+
+    // Ends the pipeline after the named pass, so --dump-tac shows the
+    // code as that pass left it. Returns false if there is no such pass.
+    bool StopAfter(const char *name);
+
+    void Run(CodeGenerator *cg);
+
+    void PrintStats();
+};
+
+extern PassManager passManager;
+
+#endif
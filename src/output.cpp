@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include "output.h"
+
+
+OutputSink asmOut;
+
+// Retries short writes and EINTR; gives up on any other error.
+static void WriteAll(int fd, const char *s, size_t n) {
+    size_t done = 0;
+    while (done < n) {
+        ssize_t w = write(fd, s + done, n - done);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) break;
+        done += w;
+    }
+}
+
+OutputSink::OutputSink() : fd(1), buf(NULL), len(0), bytes(0) {}
+
+
+bool OutputSink::Open(const char *path) {
+    int f = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (f < 0) return false;
+    Close();
+    fd = f;
+    return true;
+}
+
+
+void OutputSink::Write(const char *s, size_t n) {
+    if (buf == NULL) buf = (char *) malloc(BufSize);
+    if (len + n > BufSize) {
+        Flush();
+        if (n > BufSize) {
+            WriteAll(fd, s, n);
+            bytes += n;
+            return;
+        }
+    }
+    memcpy(buf + len, s, n);
+    len += n;
+    bytes += n;
+}
+
+
+void OutputSink::Printf(const char *fmt, ...) {
+    char line[1024];
+    va_list args;
+
+    va_start(args, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (n >= (int) sizeof(line)) n = sizeof(line) - 1;
+    Write(line, n);
+}
+
+
+void OutputSink::Flush() {
+    // anything printed through stdio (e.g. "syntax error") goes first
+    if (fd == 1) fflush(stdout);
+    WriteAll(fd, buf, len);
+    len = 0;
+}
+
+
+void OutputSink::Close() {
+    Flush();
+    if (fd > 2) close(fd);
+    fd = 1;
+}
@@ -0,0 +1,35 @@
+#ifndef _H_output
+#define _H_output
+
+#include <stddef.h>
+
+// Buffered sink for the generated assembly. Text collects in a large
+// buffer and goes to the file descriptor with one write per flush.
+class OutputSink {
+private:
+    static const size_t BufSize = 1024 * 1024;
+
+    int fd;
+    char *buf;
+    size_t len;
+    long bytes;
+
+public:
+    OutputSink();
+
+    bool Open(const char *path);
+
+    void Write(const char *s, size_t n);
+
+    void Printf(const char *fmt, ...);
+
+    void Flush();
+
+    void Close();
+
+    long BytesWritten() const { return bytes; }
+};
+
+extern OutputSink asmOut;
+
+#endif
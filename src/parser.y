@@ -21,7 +21,7 @@ void yyerror(const char *msg);
     bool booleanLiteral;
     char *stringLiteral;
     double doubleLiteral;
-    char identifier[MaxIdentLen+1];
+    const char *identifier;
 
     Program *program;
 
@@ -134,13 +134,12 @@ DeclList
       if (semantic_error != 0){
 	  CodeGenerator *CG = new CodeGenerator();
 	  CG->GenLabel("main");
-	  BeginFunc *bf = CG->GenBeginFunc();
+	  CG->GenBeginFunc();
 	  BuiltIn f = PrintString;
 	  char const * str = "Semantic Error";
 	  Location *l = CG->GenLoadConstant(str);
 
 	  CG->GenBuiltInCall(f, l);
-	  bf->SetFrameSize(CG->GetFrameSize());
 	  CG->GenEndFunc();
 
 	  CG->DoFinalCodeGen();
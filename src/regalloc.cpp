@@ -0,0 +1,182 @@
+#include <algorithm>
+#include "regalloc.h"
+
+
+LinearScan::LinearScan(Variables *v, const Liveness *l)
+        : vars(v), live(l), num_spilled(0), num_coalesced(0) {
+    BuildIntervals();
+    Allocate();
+}
+
+LinearScan::~LinearScan() {
+    for (size_t i = 0; i < intervals.size(); i++)
+        delete intervals[i];
+}
+
+void LinearScan::Extend(int v, int pos, bool def) {
+    LiveInterval *it = of_var[v];
+    if (!it) return;
+    if (it->start < 0 || pos < it->start) it->start = pos;
+    if (pos > it->end) it->end = pos;
+    it->points.push_back(def ? -pos - 1 : pos);
+}
+
+static int PointPos(int p) {
+    return p < 0 ? -p - 1 : p;
+}
+
+// a def sorts before the live-out point at the same position
+static bool ByPos(int a, int b) {
+    return PointPos(a) < PointPos(b) || (PointPos(a) == PointPos(b) && a < b);
+}
+
+// True if other holds no value anyone reads while it is live: other is
+// neither mentioned nor live inside it, and is next written, not read.
+bool LinearScan::DeadDuring(const LiveInterval *it,
+                            const LiveInterval *other) const {
+    const std::vector<int> &p = other->points;
+    std::vector<int>::const_iterator k = std::lower_bound(
+            p.begin(), p.end(), it->start, ByPos);
+    return k == p.end() || (PointPos(*k) > it->end && *k < 0);
+}
+
+static bool ByStart(const LiveInterval *a, const LiveInterval *b) {
+    return a->start < b->start || (a->start == b->start && a->var < b->var);
+}
+
+void LinearScan::BuildIntervals() {
+    CFG *cfg = vars->GetCFG();
+    const std::vector<TacInstr> &code = cfg->GetFunction()->code;
+
+    of_var.assign(vars->NumVars(), NULL);
+    for (int v = 0; v < vars->NumVars(); v++) {
+        if (vars->IsTracked(v)) {
+            of_var[v] = new LiveInterval(v);
+            intervals.push_back(of_var[v]);
+        }
+    }
+
+    for (int b = 0; b < cfg->NumBlocks(); b++) {
+        BasicBlock *bb = cfg->Block(b);
+        double scale = 1;
+        for (int d = 0; d < bb->loop_depth && d < 4; d++)
+            scale *= 10;
+        if (cfg->IsReachable(b)) {
+            const SparseBitSet &in = live->In(b), &out = live->Out(b);
+            for (int k = in.NextSet(0); k >= 0; k = in.NextSet(k + 1))
+                Extend(vars->VarOfBit(k), 2 * bb->first);
+            for (int k = out.NextSet(0); k >= 0; k = out.NextSet(k + 1))
+                Extend(vars->VarOfBit(k), 2 * bb->end - 1);
+        }
+        for (int i = bb->first; i < bb->end; i++) {
+            int d = vars->Def(i);
+            for (int k = 0; k < 2; k++) {
+                int u = vars->Use(i, k);
+                if (u >= 0 && of_var[u]) {
+                    Extend(u, 2 * i);
+                    of_var[u]->uses += scale;
+                }
+            }
+            if (d >= 0 && of_var[d]) {
+                Extend(d, 2 * i + 1, true);
+                of_var[d]->uses += scale;
+            }
+            if (code[i].op == TacLCall || code[i].op == TacACall)
+                calls.push_back(i);
+            if (code[i].op == TacAssign && d >= 0 && of_var[d]
+                && of_var[vars->Use(i, 0)]) {
+                int s = vars->Use(i, 0);
+                if (of_var[d]->hint < 0) of_var[d]->hint = s;
+                if (of_var[s]->hint < 0) of_var[s]->hint = d;
+            }
+        }
+    }
+
+    // a value crosses a call if it is held before the call and read after
+    std::vector<LiveInterval *> kept;
+    for (size_t i = 0; i < intervals.size(); i++) {
+        LiveInterval *it = intervals[i];
+        if (it->start < 0) {
+            of_var[it->var] = NULL;
+            delete it;
+            continue;
+        }
+        std::vector<int>::iterator c = std::lower_bound(
+                calls.begin(), calls.end(), (it->start + 1) / 2);
+        it->crosses_call = c != calls.end() && 2 * *c + 1 < it->end;
+        it->weight = it->uses / ((it->end - it->start) / 2 + 1);
+        std::stable_sort(it->points.begin(), it->points.end(), ByPos);
+        kept.push_back(it);
+    }
+    intervals.swap(kept);
+    std::sort(intervals.begin(), intervals.end(), ByStart);
+}
+
+bool LinearScan::Compatible(const LiveInterval *it, int reg) const {
+    return !it->crosses_call || reg >= Mips::NumTempHomes;
+}
+
+static const double MinSavedUses = 10;
+
+void LinearScan::Allocate() {
+    const int numRegs = Mips::NumTempHomes + Mips::NumSavedHomes;
+    std::vector<LiveInterval *> holder(numRegs, (LiveInterval *) NULL);
+    // the holder is whichever occupant of a register ends last; guest_end
+    // is the last end among the others coalesced into it, before which
+    // the register can be neither evicted nor shared again
+    std::vector<int> guest_end(numRegs, -1);
+
+    for (size_t n = 0; n < intervals.size(); n++) {
+        LiveInterval *cur = intervals[n];
+        for (int r = 0; r < numRegs; r++)
+            if (holder[r] && holder[r]->end < cur->start) holder[r] = NULL;
+        if (cur->crosses_call && cur->uses < MinSavedUses) {
+            num_spilled++;
+            continue;
+        }
+
+        int reg = -1;
+        LiveInterval *h = cur->hint >= 0 ? of_var[cur->hint] : NULL;
+        if (h && h->reg >= 0 && Compatible(cur, h->reg)
+            && (!holder[h->reg] || (holder[h->reg] == h && DeadDuring(cur, h)
+                                    && guest_end[h->reg] < cur->start))) {
+            reg = h->reg;
+            num_coalesced++;
+        }
+        for (int r = 0; r < numRegs && reg < 0; r++)
+            if (!holder[r] && Compatible(cur, r)) reg = r;
+
+        if (reg < 0) {
+            LiveInterval *victim = NULL;
+            for (int r = 0; r < numRegs; r++)
+                if (Compatible(cur, r) && guest_end[r] < cur->start
+                    && (!victim || holder[r]->weight < victim->weight))
+                    victim = holder[r];
+            if (!victim || victim->weight >= cur->weight) {
+                num_spilled++;
+                continue;
+            }
+            reg = victim->reg;
+            victim->reg = -1;
+            holder[reg] = NULL;
+            num_spilled++;
+        }
+        cur->reg = reg;
+        LiveInterval *prev = holder[reg];
+        if (prev && prev->end > cur->end) {
+            guest_end[reg] = std::max(guest_end[reg], cur->end);
+        } else {
+            if (prev) guest_end[reg] = std::max(guest_end[reg], prev->end);
+            holder[reg] = cur;
+        }
+    }
+}
+
+int LinearScan::RegisterOf(int var) const {
+    return of_var[var] ? of_var[var]->reg : -1;
+}
+
+bool LinearScan::LiveOnEntry(int var) const {
+    int bit = vars->Bit(var);
+    return bit >= 0 && live->In(0).Test(bit);
+}
@@ -0,0 +1,77 @@
+#ifndef _H_regalloc
+#define _H_regalloc
+
+#include <vector>
+#include "codegen.h"
+#include "cfg.h"
+#include "dataflow.h"
+
+
+// Hull of the positions where a variable is live. Instruction i reads
+// at 2i and writes at 2i + 1, so a value last read by an instruction
+// can share a register with the one it defines.
+class LiveInterval {
+public:
+    int var;
+    int start, end;
+    double uses;
+    double weight;
+    bool crosses_call;
+    int reg;
+    int hint;
+    // positions where the variable is read, written or live across a
+    // block boundary, sorted by position; a def at p is stored as -p - 1
+    std::vector<int> points;
+
+    LiveInterval(int v) : var(v), start(-1), end(-1), uses(0), weight(0),
+                          crosses_call(false), reg(-1), hint(-1) {}
+};
+
+
+// Poletto-Sarkar linear scan over a function's fp-relative locals,
+// parameters and temps. Registers are numbered as Mips's homes: the
+// caller-saved ones first, then the callee-saved ones, which are the
+// only ones an interval that crosses a call may take. When none is
+// free the lowest-weight interval (uses scaled by loop depth, per unit
+// of length) stays in memory. A callee-saved register costs a save and
+// a restore on every call of the function, so values that cross calls
+// only get one if they are used in a loop or often. A copy's source and
+// destination get the same register when it is free, or when one is
+// dead for the whole of the other's interval, so the move disappears.
+class LinearScan {
+private:
+    Variables *vars;
+    const Liveness *live;
+    std::vector<LiveInterval *> intervals;
+    std::vector<LiveInterval *> of_var;
+    std::vector<int> calls;
+    int num_spilled, num_coalesced;
+
+    void BuildIntervals();
+
+    void Extend(int v, int pos, bool def = false);
+
+    bool DeadDuring(const LiveInterval *it, const LiveInterval *other) const;
+
+    bool Compatible(const LiveInterval *it, int reg) const;
+
+    void Allocate();
+
+public:
+    LinearScan(Variables *vars, const Liveness *live);
+
+    ~LinearScan();
+
+    // Register for var, or -1 if it lives in its stack slot.
+    int RegisterOf(int var) const;
+
+    // Whether var's register must be loaded from its slot on entry
+    // (parameters, and locals read before they are written).
+    bool LiveOnEntry(int var) const;
+
+    int NumSpilled() const { return num_spilled; }
+
+    int NumCoalesced() const { return num_coalesced; }
+};
+
+#endif
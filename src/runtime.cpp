@@ -0,0 +1,181 @@
+#include "runtime.h"
+
+
+// Hand-written MIPS for the Decaf runtime, one entry per BuiltIn. Only the
+// routines the program calls are copied into the output.
+const char *const runtimeText[NumBuiltIns] = {
+        "_Alloc:\n"
+        "        subu    $sp, $sp, 8\n"
+        "        sw      $fp, 8($sp)\n"
+        "        sw      $ra, 4($sp)\n"
+        "        addiu   $fp, $sp, 8\n"
+        "        li      $v0, 9\n"
+        "        lw      $a0, 4($fp)\n"
+        "        syscall\n"
+        "        move    $sp, $fp\n"
+        "        lw      $ra, -4($fp)\n"
+        "        lw      $fp, 0($fp)\n"
+        "        jr      $ra\n",
+
+        "_ReadLine:\n"
+        "        subu    $sp, $sp, 8\n"
+        "        sw      $fp, 8($sp)\n"
+        "        sw      $ra, 4($sp)\n"
+        "        addiu   $fp, $sp, 8\n"
+        "        subu    $sp, $sp, 4\n"
+        "\n"
+        "\n"
+        "        li      $a0, 128\n"
+        "        li      $v0, 9\n"
+        "        syscall\n"
+        "\n"
+        "\n"
+        "        li      $a1, 128\n"
+        "        move    $a0, $v0\n"
+        "        li      $v0, 8\n"
+        "        syscall\n"
+        "\n"
+        "        move    $t1, $a0\n"
+        "\n"
+        "bloop4: lb      $t5, ($t1)\n"
+        "        beqz    $t5, eloop4\n"
+        "        addi    $t1, 1\n"
+        "        b       bloop4\n"
+        "\n"
+        "eloop4: addi    $t1, -1\n"
+        "        li      $t6, 0\n"
+        "        sb      $t6, ($t1)\n"
+        "\n"
+        "        move    $v0, $a0\n"
+        "        move    $sp, $fp\n"
+        "        lw      $ra, -4($fp)\n"
+        "        lw      $fp, 0($fp)\n"
+        "        jr      $ra\n",
+
+        "_ReadInteger:\n"
+        "        subu    $sp, $sp, 8\n"
+        "        sw      $fp, 8($sp)\n"
+        "        sw      $ra, 4($sp)\n"
+        "        addiu   $fp, $sp, 8\n"
+        "        subu    $sp, $sp, 4\n"
+        "        li      $v0, 5\n"
+        "        syscall\n"
+        "        move    $sp, $fp\n"
+        "        lw      $ra, -4($fp)\n"
+        "        lw      $fp, 0($fp)\n"
+        "        jr      $ra\n",
+
+        "_StringEqual:\n"
+        "        subu    $sp, $sp, 8\n"
+        "        sw      $fp, 8($sp)\n"
+        "        sw      $ra, 4($sp)\n"
+        "        addiu   $fp, $sp, 8\n"
+        "        subu    $sp, $sp, 4\n"
+        "\n"
+        "        li      $v0, 0\n"
+        "\n"
+        "\n"
+        "        lw      $t0, 4($fp)\n"
+        "        li      $t3, 0\n"
+        "\n"
+        "bloop1: lb      $t5, ($t0)\n"
+        "        beqz    $t5, eloop1\n"
+        "        addi    $t0, 1\n"
+        "        addi    $t3, 1\n"
+        "        b       bloop1\n"
+        "\n"
+        "eloop1:\n"
+        "        lw      $t1, 8($fp)\n"
+        "        li      $t4, 0\n"
+        "\n"
+        "bloop2: lb      $t5, ($t1)\n"
+        "        beqz    $t5, eloop2\n"
+        "        addi    $t1, 1\n"
+        "        addi    $t4, 1\n"
+        "        b       bloop2\n"
+        "\n"
+        "eloop2: bne     $t3,$t4,end1\n"
+        "\n"
+        "        lw      $t0, 4($fp)\n"
+        "        lw      $t1, 8($fp)\n"
+        "        li      $t3, 0\n"
+        "\n"
+        "bloop3: lb      $t5, ($t0)\n"
+        "        lb      $t6, ($t1)\n"
+        "        bne     $t5, $t6, end1\n"
+        "        beqz    $t5, eloop3\n"
+        "        addi    $t3, 1\n"
+        "        addi    $t0, 1\n"
+        "        addi    $t1, 1\n"
+        "        b       bloop3\n"
+        "\n"
+        "eloop3: li      $v0, 1\n"
+        "\n"
+        "end1:   move    $sp, $fp\n"
+        "        lw      $ra, -4($fp)\n"
+        "        lw      $fp, 0($fp)\n"
+        "        jr      $ra\n",
+
+        "_PrintInt:\n"
+        "        subu    $sp, $sp, 8\n"
+        "        sw      $fp, 8($sp)\n"
+        "        sw      $ra, 4($sp)\n"
+        "        addiu   $fp, $sp, 8\n"
+        "        li      $v0, 1\n"
+        "        lw      $a0, 4($fp)\n"
+        "        syscall\n"
+        "        move    $sp, $fp\n"
+        "        lw      $ra, -4($fp)\n"
+        "        lw      $fp, 0($fp)\n"
+        "        jr      $ra\n",
+
+        "_PrintString:\n"
+        "        subu    $sp, $sp, 8\n"
+        "        sw      $fp, 8($sp)\n"
+        "        sw      $ra, 4($sp)\n"
+        "        addiu   $fp, $sp, 8\n"
+        "        li      $v0, 4\n"
+        "        lw      $a0, 4($fp)\n"
+        "        syscall\n"
+        "        move    $sp, $fp\n"
+        "        lw      $ra, -4($fp)\n"
+        "        lw      $fp, 0($fp)\n"
+        "        jr      $ra\n",
+
+        "_PrintBool:\n"
+        "        subu    $sp, $sp, 8\n"
+        "        sw      $fp, 8($sp)\n"
+        "        sw      $ra, 4($sp)\n"
+        "        addiu   $fp, $sp, 8\n"
+        "        lw      $t1, 4($fp)\n"
+        "        blez    $t1, fbr\n"
+        "        li      $v0, 4\n"
+        "        la      $a0, TRUE\n"
+        "        syscall\n"
+        "        b end\n"
+        "\n"
+        "fbr:    li      $v0, 4\n"
+        "        la      $a0, FALSE\n"
+        "        syscall\n"
+        "\n"
+        "end:    move    $sp, $fp\n"
+        "        lw      $ra, -4($fp)\n"
+        "        lw      $fp, 0($fp)\n"
+        "        jr      $ra\n",
+
+        "_Halt:\n"
+        "        li      $v0, 10\n"
+        "        syscall\n"
+};
+
+const char *const runtimeData[NumBuiltIns] = {
+        NULL,
+        NULL,
+        NULL,
+        NULL,
+        NULL,
+        NULL,
+        "TRUE:.asciiz \"true\"\n"
+        "FALSE:.asciiz \"false\"\n",
+        NULL
+};
@@ -0,0 +1,12 @@
+#ifndef _H_runtime
+#define _H_runtime
+
+#include "codegen.h"
+
+// Assembly for each runtime routine and the data it needs (or NULL),
+// indexed by BuiltIn.
+extern const char *const runtimeText[NumBuiltIns];
+
+extern const char *const runtimeData[NumBuiltIns];
+
+#endif
@@ -13,16 +13,21 @@ SymbolTable *scopeHandler;
 class Scope {
 protected:
     Hashtable<Decl *> *ht;
-    const char *parent;
-    std::list<const char *> *interface;
+    Hashtable<Decl *> *members;
+    const char *parentName;
+    Scope *parent;
+    std::list<const char *> *interfaceNames;
+    std::list<Scope *> *interface;
     const char *owner;
 
 public:
     Scope() {
         ht = NULL;
+        members = NULL;
+        parentName = NULL;
         parent = NULL;
-        interface = new std::list<const char *>;
-        interface->clear();
+        interfaceNames = new std::list<const char *>;
+        interface = new std::list<Scope *>;
         owner = NULL;
     }
 
@@ -32,17 +37,25 @@ public:
 
     Hashtable<Decl *> *GetHT() { return ht; }
 
-    bool HasParent() { return parent == NULL ? false : true; }
+    void SetMembers(Hashtable<Decl *> *m) { members = m; }
 
-    void SetParent(const char *p) { parent = p; }
+    Hashtable<Decl *> *GetMembers() { return members; }
 
-    const char *GetParent() { return parent; }
+    void SetParentName(const char *p) { parentName = p; }
 
-    bool HasInterface() { return !interface->empty(); }
+    const char *GetParentName() { return parentName; }
 
-    void AddInterface(const char *p) { interface->push_back(p); }
+    void SetParent(Scope *p) { parent = p; }
 
-    std::list<const char *> *GetInterface() { return interface; }
+    Scope *GetParent() { return parent; }
+
+    void AddInterfaceName(const char *p) { interfaceNames->push_back(p); }
+
+    std::list<const char *> *GetInterfaceNames() { return interfaceNames; }
+
+    void AddInterface(Scope *p) { interface->push_back(p); }
+
+    std::list<Scope *> *GetInterface() { return interface; }
 
     bool HasOwner() { return owner == NULL ? false : true; }
 
@@ -59,6 +72,8 @@ SymbolTable::SymbolTable() {
     scopes->clear();
     scopes->push_back(new Scope());
 
+    ownerScopes = new Hashtable<Scope *>;
+
 
     activeScopes = new std::vector<int>;
     activeScopes->clear();
@@ -66,8 +81,8 @@ SymbolTable::SymbolTable() {
 
 
     cur_scope = 0;
-    scope_cnt = 0;
     id_cnt = 0;
+    lookup_cnt = 0;
 }
 
 
@@ -78,64 +93,77 @@ SymbolTable::ResetSymbolTable() {
     activeScopes->push_back(0);
 
     cur_scope = 0;
-    scope_cnt = 0;
     id_cnt = 0;
 }
 
 
-void
+int
 SymbolTable::BuildScope() {
 
-    scope_cnt++;
+    int scope = scopes->size();
     scopes->push_back(new Scope());
-    activeScopes->push_back(scope_cnt);
-    cur_scope = scope_cnt;
+    activeScopes->push_back(scope);
+    cur_scope = scope;
+    return scope;
 }
 
 
-void
+int
 SymbolTable::BuildScope(const char *key) {
 
-    scope_cnt++;
-    scopes->push_back(new Scope());
-    scopes->at(scope_cnt)->SetOwner(key);
-    activeScopes->push_back(scope_cnt);
-    cur_scope = scope_cnt;
+    int scope = BuildScope();
+    scopes->at(scope)->SetOwner(key);
+    if (!ownerScopes->Lookup(key))
+        ownerScopes->Enter(key, scopes->at(scope));
+    return scope;
 }
 
 
 void
-SymbolTable::EnterScope() {
+SymbolTable::EnterScope(int scope) {
 
-    scope_cnt++;
-    activeScopes->push_back(scope_cnt);
-    cur_scope = scope_cnt;
+    activeScopes->push_back(scope);
+    cur_scope = scope;
 }
 
 
-int
+Scope *
 SymbolTable::FindScopeFromOwnerName(const char *key) {
-    int scope = -1;
+    return ownerScopes->Lookup(key);
+}
+
+
+void
+SymbolTable::LinkScopes() {
 
     for (int i = 0; i < scopes->size(); i++) {
-        if (scopes->at(i)->HasOwner()) {
-            if (!strcmp(key, scopes->at(i)->GetOwner())) {
-                scope = i;;
-                break;
-            }
+        Scope *s = scopes->at(i);
+        if (s->GetParentName()) {
+            s->SetParent(FindScopeFromOwnerName(s->GetParentName()));
+        }
+
+        std::list<const char *> *names = s->GetInterfaceNames();
+        for (std::list<const char *>::iterator it = names->begin();
+             it != names->end(); it++) {
+            Scope *sc = FindScopeFromOwnerName(*it);
+            if (sc) s->AddInterface(sc);
         }
     }
+}
 
 
-    return scope;
+void
+SymbolTable::SetMemberTable(int scope, Hashtable<Decl *> *members) {
+    scopes->at(scope)->SetMembers(members);
 }
 
 
 Decl *
 SymbolTable::Lookup(Identifier *id) {
+    lookup_cnt++;
     Decl *d = NULL;
-    const char *parent = NULL;
     const char *key = id->GetIdName();
+    Scope *cur = scopes->at(cur_scope);
 
 
     for (int i = activeScopes->size(); i > 0; --i) {
@@ -148,23 +176,11 @@ SymbolTable::Lookup(Identifier *id) {
         }
         if (d != NULL) break;
 
-        while (s->HasParent()) {
-            parent = s->GetParent();
-            scope = FindScopeFromOwnerName(parent);
-            if (scope != -1) {
-                if (scope == cur_scope) {
-
-                    break;
-                } else {
-                    s = scopes->at(scope);
-                    if (s->HasHT()) {
-                        d = s->GetHT()->Lookup(key);
-                    }
-                    if (d != NULL) break;
-                }
-            } else {
-                break;
+        while ((s = s->GetParent()) != NULL && s != cur) {
+            if (s->HasHT()) {
+                d = s->GetHT()->Lookup(key);
             }
+            if (d != NULL) break;
         }
         if (d != NULL) break;
     }
@@ -175,29 +191,23 @@ SymbolTable::Lookup(Identifier *id) {
 
 Decl *
 SymbolTable::LookupParent(Identifier *id) {
+    lookup_cnt++;
     Decl *d = NULL;
-    const char *parent = NULL;
     const char *key = id->GetIdName();
-    Scope *s = scopes->at(cur_scope);
-
+    Scope *cur = scopes->at(cur_scope);
+    Scope *s = cur;
 
-    while (s->HasParent()) {
-        parent = s->GetParent();
-        int scope = FindScopeFromOwnerName(parent);
 
+    Scope *p = cur->GetParent();
+    if (p && p != cur && p->GetMembers()) {
+        return p->GetMembers()->Lookup(key);
+    }
 
-        if (scope != -1) {
-            if (scope == cur_scope) {
-
-                break;
-            } else {
-                s = scopes->at(scope);
-                if (s->HasHT()) {
-                    d = s->GetHT()->Lookup(key);
-                }
-                if (d != NULL) break;
-            }
+    while ((s = s->GetParent()) != NULL && s != cur) {
+        if (s->HasHT()) {
+            d = s->GetHT()->Lookup(key);
         }
+        if (d != NULL) break;
     }
 
     return d;
@@ -206,74 +216,56 @@ SymbolTable::LookupParent(Identifier *id) {
 
 Decl *
 SymbolTable::LookupInterface(Identifier *id) {
+    lookup_cnt++;
     Decl *d = NULL;
     const char *key = id->GetIdName();
-    int scope;
-    Scope *s = scopes->at(cur_scope);
-
+    std::list<Scope *> *itfc = scopes->at(cur_scope)->GetInterface();
 
-    if (s->HasInterface()) {
 
-        std::list<const char *> *itfc = s->GetInterface();
-
-        for (std::list<const char *>::iterator it = itfc->begin();
-             it != itfc->end(); it++) {
-            scope = FindScopeFromOwnerName(*it);
-
-
-            if (scope != -1) {
-                Scope *sc = scopes->at(scope);
-                if (sc->HasHT()) {
-                    d = sc->GetHT()->Lookup(key);
-                }
-                if (d != NULL) break;
-            }
+    for (std::list<Scope *>::iterator it = itfc->begin();
+         it != itfc->end(); it++) {
+        Scope *sc = *it;
+        if (sc->HasHT()) {
+            d = sc->GetHT()->Lookup(key);
         }
+        if (d != NULL) break;
     }
     return d;
 }
 
 
 Decl *SymbolTable::LookupField(Identifier *base, Identifier *field) {
+    lookup_cnt++;
     Decl *d = NULL;
-    const char *b = base->GetIdName();
     const char *f = field->GetIdName();
+    Scope *cur = scopes->at(cur_scope);
 
 
-    int scope = FindScopeFromOwnerName(b);
-    if (scope == -1) return NULL;
+    Scope *s = FindScopeFromOwnerName(base->GetIdName());
+    if (s == NULL) return NULL;
 
+    if (s->GetMembers()) {
+        return s->GetMembers()->Lookup(f);
+    }
 
-    Scope *s = scopes->at(scope);
     if (s->HasHT()) {
         d = s->GetHT()->Lookup(f);
     }
     if (d != NULL) return d;
 
 
-    while (s->HasParent()) {
-        b = s->GetParent();
-        scope = FindScopeFromOwnerName(b);
-        if (scope != -1) {
-            if (scope == cur_scope) {
-
-                break;
-            } else {
-                s = scopes->at(scope);
-                if (s->HasHT()) {
-                    d = s->GetHT()->Lookup(f);
-                }
-                if (d != NULL) break;
-            }
-        } else {
-            break;
+    while ((s = s->GetParent()) != NULL && s != cur) {
+        if (s->HasHT()) {
+            d = s->GetHT()->Lookup(f);
         }
+        if (d != NULL) break;
     }
     return d;
 }
 
 
 Decl *SymbolTable::LookupThis() {
+    lookup_cnt++;
 
     Decl *d = NULL;
 
@@ -313,6 +305,7 @@ SymbolTable::InsertSymbol(Decl *decl) {
 
 bool
 SymbolTable::LocalLookup(Identifier *id) {
+    lookup_cnt++;
     Decl *d = NULL;
     const char *key = id->GetIdName();
     Scope *s = scopes->at(cur_scope);
@@ -336,12 +329,12 @@ SymbolTable::ExitScope() {
 
 void
 SymbolTable::SetScopeParent(const char *key) {
-    scopes->at(cur_scope)->SetParent(key);
+    scopes->at(cur_scope)->SetParentName(key);
 }
 
 
 void
 SymbolTable::SetInterface(const char *key) {
-    scopes->at(cur_scope)->AddInterface(key);
+    scopes->at(cur_scope)->AddInterfaceName(key);
 }
 
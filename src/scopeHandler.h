@@ -17,22 +17,23 @@ class Scope;
 class SymbolTable {
 protected:
     std::vector<Scope *> *scopes;
+    Hashtable<Scope *> *ownerScopes;
     std::vector<int> *activeScopes;
     int cur_scope;
-    int scope_cnt;
     int id_cnt;
+    int lookup_cnt;
 
-    int FindScopeFromOwnerName(const char *owner);
+    Scope *FindScopeFromOwnerName(const char *owner);
 
 public:
     SymbolTable();
 
 
-    void BuildScope();
+    int BuildScope();
 
-    void BuildScope(const char *key);
+    int BuildScope(const char *key);
 
-    void EnterScope();
+    void EnterScope(int scope);
 
     Decl *Lookup(Identifier *id);
 
@@ -55,8 +56,14 @@ public:
 
     void SetInterface(const char *key);
 
+    void LinkScopes();
+
+    void SetMemberTable(int scope, Hashtable<Decl *> *members);
+
 
     void ResetSymbolTable();
+
+    int GetLookupCount() { return lookup_cnt; }
 };
 
 extern SymbolTable *scopeHandler;
@@ -0,0 +1,388 @@
+#include "ssa.h"
+
+
+SSAForm::SSAForm(Variables *v, const Liveness *l)
+        : cfg(v->GetCFG()), vars(v), live(l) {
+    ComputeFrontiers();
+    PlacePhis();
+    Rename();
+}
+
+SSAForm::~SSAForm() {
+    for (size_t i = 0; i < phis.size(); i++)
+        delete phis[i];
+}
+
+int SSAForm::NewValue(int instr, int phi) {
+    value_instr.push_back(instr);
+    value_phi.push_back(phi);
+    return value_instr.size() - 1;
+}
+
+// Cooper, Harvey and Kennedy: walk up from each predecessor of a join
+// to the join's idom.
+void SSAForm::ComputeFrontiers() {
+    int n = cfg->NumBlocks();
+    frontier.assign(n, std::vector<int>());
+    for (int b = 0; b < n; b++) {
+        BasicBlock *bb = cfg->Block(b);
+        if (!cfg->IsReachable(b) || bb->preds.size() < 2) continue;
+        for (size_t p = 0; p < bb->preds.size(); p++) {
+            int r = bb->preds[p];
+            if (!cfg->IsReachable(r)) continue;
+            while (r >= 0 && r != bb->idom) {
+                if (frontier[r].empty() || frontier[r].back() != b)
+                    frontier[r].push_back(b);
+                r = cfg->Block(r)->idom;
+            }
+        }
+    }
+}
+
+void SSAForm::PlacePhis() {
+    int n = cfg->NumBlocks();
+    int nb = vars->NumBits();
+    std::vector<std::vector<int> > defBlocks(nb);
+
+    block_phis.assign(n, std::vector<int>());
+    for (int b = 0; b < n; b++) {
+        BasicBlock *bb = cfg->Block(b);
+        if (!cfg->IsReachable(b)) continue;
+        for (int i = bb->first; i < bb->end; i++) {
+            int d = vars->Def(i);
+            if (d < 0 || vars->Bit(d) < 0 || !vars->IsTracked(d)) continue;
+            std::vector<int> &db = defBlocks[vars->Bit(d)];
+            if (db.empty() || db.back() != b) db.push_back(b);
+        }
+    }
+
+    std::vector<int> reached(n, -1);
+    std::vector<int> work;
+    for (int bit = 0; bit < nb; bit++) {
+        if (defBlocks[bit].empty()) continue;
+        int var = vars->VarOfBit(bit);
+        work = defBlocks[bit];
+        for (size_t i = 0; i < work.size(); i++)
+            reached[work[i]] = -2 - bit;
+        while (!work.empty()) {
+            int b = work.back();
+            work.pop_back();
+            for (size_t f = 0; f < frontier[b].size(); f++) {
+                int y = frontier[b][f];
+                if (reached[y] == bit) continue;
+                if (live->In(y).Test(bit)) {
+                    PhiNode *phi = new PhiNode(var, y,
+                                               cfg->Block(y)->preds.size());
+                    block_phis[y].push_back(phis.size());
+                    phis.push_back(phi);
+                }
+                if (reached[y] != -2 - bit) work.push_back(y);
+                reached[y] = bit;
+            }
+        }
+    }
+}
+
+void SSAForm::Rename() {
+    const std::vector<int> &rpo = cfg->ReversePostorder();
+    int n = cfg->NumBlocks();
+    int ni = cfg->GetFunction()->code.size();
+    int nv = vars->NumVars();
+    std::vector<std::vector<int> > children(n);
+    std::vector<std::vector<int> > stacks(nv);
+    std::vector<int> entry(nv, -1);
+    std::vector<int> log;
+
+    def_value.assign(ni, -1);
+    use_value.assign(2 * ni, -1);
+    for (size_t i = 1; i < rpo.size(); i++)
+        children[cfg->Block(rpo[i])->idom].push_back(rpo[i]);
+    if (rpo.empty()) return;
+
+    // explicit dominator-tree walk; a negative entry pops back to the
+    // log size saved when the block was entered
+    std::vector<int> walk(1, 0);
+    std::vector<size_t> marks;
+    while (!walk.empty()) {
+        int b = walk.back();
+        walk.pop_back();
+        if (b < 0) {
+            size_t mark = marks.back();
+            marks.pop_back();
+            while (log.size() > mark) {
+                stacks[log.back()].pop_back();
+                log.pop_back();
+            }
+            continue;
+        }
+
+        BasicBlock *bb = cfg->Block(b);
+        marks.push_back(log.size());
+        for (size_t k = 0; k < block_phis[b].size(); k++) {
+            PhiNode *phi = phis[block_phis[b][k]];
+            phi->value = NewValue(-1, block_phis[b][k]);
+            stacks[phi->var].push_back(phi->value);
+            log.push_back(phi->var);
+        }
+        for (int i = bb->first; i < bb->end; i++) {
+            for (int k = 0; k < 2; k++) {
+                int u = vars->Use(i, k);
+                if (u < 0 || !vars->IsTracked(u)) continue;
+                if (stacks[u].empty()) {
+                    if (entry[u] < 0) entry[u] = NewValue(-1, -1);
+                    use_value[2 * i + k] = entry[u];
+                } else {
+                    use_value[2 * i + k] = stacks[u].back();
+                }
+            }
+            int d = vars->Def(i);
+            if (d >= 0 && vars->IsTracked(d)) {
+                def_value[i] = NewValue(i, -1);
+                stacks[d].push_back(def_value[i]);
+                log.push_back(d);
+            }
+        }
+        for (size_t s = 0; s < bb->succs.size(); s++) {
+            BasicBlock *sb = cfg->Block(bb->succs[s]);
+            int j = 0;
+            while (sb->preds[j] != b) j++;
+            for (size_t k = 0; k < block_phis[sb->id].size(); k++) {
+                PhiNode *phi = phis[block_phis[sb->id][k]];
+                if (stacks[phi->var].empty()) {
+                    if (entry[phi->var] < 0) entry[phi->var] = NewValue(-1, -1);
+                    phi->args[j] = entry[phi->var];
+                } else {
+                    phi->args[j] = stacks[phi->var].back();
+                }
+            }
+        }
+
+        walk.push_back(-1);
+        for (size_t c = children[b].size(); c-- > 0;)
+            walk.push_back(children[b][c]);
+    }
+}
+
+
+SCCP::SCCP(SSAForm *s) : ssa(s), cfg(s->GetCFG()), folded(0), branches(0),
+                         dropped(0) {
+    int n = cfg->NumBlocks();
+    level.assign(ssa->NumValues(), Top);
+    value.assign(ssa->NumValues(), 0);
+    for (int v = 0; v < ssa->NumValues(); v++)
+        if (ssa->ValueInstr(v) < 0 && ssa->ValuePhi(v) < 0) level[v] = Bottom;
+    exec_block.assign(n, false);
+    exec_in.resize(n);
+    for (int b = 0; b < n; b++)
+        exec_in[b].assign(cfg->Block(b)->preds.size(), false);
+    BuildUsers();
+}
+
+// users of each value, CSR by value: instruction i as i, phi p as -1 - p
+void SCCP::BuildUsers() {
+    int nv = ssa->NumValues();
+    int ni = cfg->GetFunction()->code.size();
+    user_start.assign(nv + 1, 0);
+    for (int i = 0; i < ni; i++)
+        for (int k = 0; k < 2; k++)
+            if (ssa->UseValue(i, k) >= 0) user_start[ssa->UseValue(i, k) + 1]++;
+    for (int p = 0; p < ssa->NumPhis(); p++) {
+        PhiNode *phi = ssa->GetPhi(p);
+        for (size_t j = 0; j < phi->args.size(); j++)
+            if (phi->args[j] >= 0) user_start[phi->args[j] + 1]++;
+    }
+    for (int v = 0; v < nv; v++)
+        user_start[v + 1] += user_start[v];
+    users.resize(user_start[nv]);
+    std::vector<int> fill(user_start.begin(), user_start.end() - 1);
+    for (int i = 0; i < ni; i++)
+        for (int k = 0; k < 2; k++)
+            if (ssa->UseValue(i, k) >= 0) users[fill[ssa->UseValue(i, k)]++] = i;
+    for (int p = 0; p < ssa->NumPhis(); p++) {
+        PhiNode *phi = ssa->GetPhi(p);
+        for (size_t j = 0; j < phi->args.size(); j++)
+            if (phi->args[j] >= 0) users[fill[phi->args[j]]++] = -1 - p;
+    }
+}
+
+void SCCP::Lower(int v, Level l, int c) {
+    if (l == Const && level[v] == Const && value[v] != c) l = Bottom;
+    if (l <= level[v]) return;
+    level[v] = l;
+    value[v] = c;
+    ssa_work.push_back(v);
+}
+
+void SCCP::MarkEdge(int from, int to) {
+    BasicBlock *bb = cfg->Block(to);
+    int j = 0;
+    while (bb->preds[j] != from) j++;
+    if (exec_in[to][j]) return;
+    exec_in[to][j] = true;
+    if (!exec_block[to]) {
+        exec_block[to] = true;
+        flow_work.push_back(to);
+    } else {
+        const std::vector<int> &ps = ssa->BlockPhis(to);
+        for (size_t k = 0; k < ps.size(); k++)
+            VisitPhi(ps[k]);
+    }
+}
+
+void SCCP::VisitBlock(int b) {
+    BasicBlock *bb = cfg->Block(b);
+    const std::vector<int> &ps = ssa->BlockPhis(b);
+    for (size_t k = 0; k < ps.size(); k++)
+        VisitPhi(ps[k]);
+    for (int i = bb->first; i < bb->end; i++)
+        VisitInstr(i);
+
+    const TacInstr &last = cfg->GetFunction()->code[bb->end - 1];
+    if (last.op == TacGoto && !bb->succs.empty())
+        MarkEdge(b, bb->succs[0]);
+    else if (last.op != TacIfZ && last.op != TacGoto && last.op != TacReturn
+             && last.op != TacEndFunc && b + 1 < cfg->NumBlocks())
+        MarkEdge(b, b + 1);
+}
+
+void SCCP::VisitPhi(int p) {
+    PhiNode *phi = ssa->GetPhi(p);
+    Level l = Top;
+    int c = 0;
+    for (size_t j = 0; j < phi->args.size() && l != Bottom; j++) {
+        if (!exec_in[phi->block][j] || phi->args[j] < 0) continue;
+        int a = phi->args[j];
+        if (level[a] == Top) continue;
+        if (level[a] == Bottom || (l == Const && value[a] != c)) l = Bottom;
+        else {
+            l = Const;
+            c = value[a];
+        }
+    }
+    Lower(phi->value, l, c);
+}
+
+SCCP::Level SCCP::LevelOfUse(int i, int k, int &c) const {
+    int v = ssa->UseValue(i, k);
+    if (v < 0) return Bottom;
+    c = value[v];
+    return (Level) level[v];
+}
+
+bool SCCP::Evaluate(int i, int &c, Level &l) {
+    const TacInstr &ins = cfg->GetFunction()->code[i];
+    int a = 0, b = 0;
+    Level la, lb;
+
+    switch (ins.op) {
+        case TacLoadConstant:
+            l = Const;
+            c = ins.imm;
+            return true;
+        case TacAssign:
+            l = LevelOfUse(i, 0, c);
+            return true;
+        case TacBinaryOp:
+            la = LevelOfUse(i, 0, a);
+            lb = LevelOfUse(i, 1, b);
+            break;
+        default:
+            l = Bottom;
+            return true;
+    }
+    if (la == Bottom || lb == Bottom) {
+        l = Bottom;
+        return true;
+    }
+    if (la == Top || lb == Top) {
+        l = Top;
+        return true;
+    }
+
+    l = BinaryOp::Fold((BinaryOp::OpCode) ins.code, a, b, c) ? Const : Bottom;
+    return true;
+}
+
+void SCCP::VisitInstr(int i) {
+    int b = cfg->BlockOf(i);
+    if (!exec_block[b]) return;
+
+    const TacInstr &ins = cfg->GetFunction()->code[i];
+    int d = ssa->DefValue(i);
+    if (d >= 0) {
+        int c = 0;
+        Level l;
+        Evaluate(i, c, l);
+        Lower(d, l, c);
+    }
+    if (ins.op == TacIfZ) {
+        BasicBlock *bb = cfg->Block(b);
+        int c = 0;
+        Level l = LevelOfUse(i, 0, c);
+        int fall = b + 1 < cfg->NumBlocks() ? b + 1 : -1;
+        if (l == Top) return;
+        if ((l == Bottom || c == 0) && !bb->succs.empty())
+            MarkEdge(b, bb->succs[0]);
+        if ((l == Bottom || c != 0) && fall >= 0)
+            MarkEdge(b, fall);
+    }
+}
+
+void SCCP::Run() {
+    if (cfg->NumBlocks() == 0) return;
+    exec_block[0] = true;
+    flow_work.push_back(0);
+    while (!flow_work.empty() || !ssa_work.empty()) {
+        if (!flow_work.empty()) {
+            int b = flow_work.back();
+            flow_work.pop_back();
+            VisitBlock(b);
+            continue;
+        }
+        int v = ssa_work.back();
+        ssa_work.pop_back();
+        for (int k = user_start[v]; k < user_start[v + 1]; k++) {
+            int u = users[k];
+            if (u >= 0) VisitInstr(u);
+            else if (exec_block[ssa->GetPhi(-1 - u)->block]) VisitPhi(-1 - u);
+        }
+    }
+}
+
+bool SCCP::Apply() {
+    std::vector<TacInstr> &code = cfg->GetFunction()->code;
+    std::vector<TacInstr> result;
+
+    result.reserve(code.size());
+    for (int i = 0; i < (int) code.size(); i++) {
+        TacInstr ins = code[i];
+        if (!exec_block[cfg->BlockOf(i)]) {
+            if (ins.op != TacLabel && ins.op != TacBeginFunc
+                && ins.op != TacEndFunc) {
+                dropped++;
+                continue;
+            }
+        } else if (ins.op == TacIfZ) {
+            int c = 0;
+            if (LevelOfUse(i, 0, c) == Const) {
+                branches++;
+                if (c != 0) continue;
+                ins.op = TacGoto;
+                ins.src1 = -1;
+            }
+        } else if (ins.op == TacAssign || ins.op == TacBinaryOp) {
+            int d = ssa->DefValue(i);
+            if (d >= 0 && level[d] == Const) {
+                folded++;
+                ins.op = TacLoadConstant;
+                ins.code = 0;
+                ins.src1 = -1;
+                ins.imm = value[d];
+            }
+        }
+        result.push_back(ins);
+    }
+    if (folded + branches + dropped == 0) return false;
+    code.swap(result);
+    return true;
+}
@@ -0,0 +1,134 @@
+#ifndef _H_ssa
+#define _H_ssa
+
+#include <vector>
+#include "codegen.h"
+#include "cfg.h"
+#include "dataflow.h"
+
+
+// A phi for one variable at the head of a block; args[j] is the value
+// flowing in from the block's j-th predecessor (-1 if unreachable).
+class PhiNode {
+public:
+    int var;
+    int value;
+    int block;
+    std::vector<int> args;
+
+    PhiNode(int v, int b, int n) : var(v), value(-1), block(b), args(n, -1) {}
+};
+
+
+// SSA form of one function's TAC, kept beside the code rather than in
+// it: instructions still name Locations, and every def and use of a
+// promotable variable (an fp-relative local, parameter or temp) is
+// mapped to an SSA value. Phis are placed on iterated dominance
+// frontiers where the variable is live. Nothing is ever renamed in the
+// code, so leaving SSA is just dropping the value numbers again.
+class SSAForm {
+private:
+    CFG *cfg;
+    Variables *vars;
+    const Liveness *live;
+    std::vector<std::vector<int> > frontier;
+    std::vector<PhiNode *> phis;
+    std::vector<std::vector<int> > block_phis;
+    std::vector<int> def_value;
+    std::vector<int> use_value;
+    std::vector<int> value_instr;
+    std::vector<int> value_phi;
+
+    void ComputeFrontiers();
+
+    void PlacePhis();
+
+    void Rename();
+
+    int NewValue(int instr, int phi);
+
+public:
+    SSAForm(Variables *vars, const Liveness *live);
+
+    ~SSAForm();
+
+    CFG *GetCFG() const { return cfg; }
+
+    Variables *GetVariables() const { return vars; }
+
+    int NumValues() const { return value_instr.size(); }
+
+    // Instruction or phi defining a value; both are -1 for the value a
+    // variable has on entry.
+    int ValueInstr(int v) const { return value_instr[v]; }
+
+    int ValuePhi(int v) const { return value_phi[v]; }
+
+    int DefValue(int instr) const { return def_value[instr]; }
+
+    int UseValue(int instr, int k) const { return use_value[2 * instr + k]; }
+
+    int NumPhis() const { return phis.size(); }
+
+    PhiNode *GetPhi(int i) const { return phis[i]; }
+
+    const std::vector<int> &BlockPhis(int b) const { return block_phis[b]; }
+
+    const std::vector<int> &Frontier(int b) const { return frontier[b]; }
+};
+
+
+// Wegman-Zadeck sparse conditional constant propagation over an SSAForm.
+// Apply rewrites the function: defs found constant become LoadConstant,
+// IfZ on a constant becomes a Goto or disappears, and code in blocks
+// never found executable is dropped (labels are kept).
+class SCCP {
+private:
+    typedef enum {
+        Top, Const, Bottom
+    } Level;
+
+    SSAForm *ssa;
+    CFG *cfg;
+    std::vector<char> level;
+    std::vector<int> value;
+    std::vector<bool> exec_block;
+    std::vector<std::vector<bool> > exec_in;
+    std::vector<int> user_start;
+    std::vector<int> users;
+    std::vector<int> flow_work;
+    std::vector<int> ssa_work;
+    int folded, branches, dropped;
+
+    void BuildUsers();
+
+    void MarkEdge(int from, int to);
+
+    void VisitBlock(int b);
+
+    void VisitPhi(int p);
+
+    void VisitInstr(int i);
+
+    void Lower(int v, Level l, int c);
+
+    bool Evaluate(int i, int &c, Level &l);
+
+    Level LevelOfUse(int i, int k, int &c) const;
+
+public:
+    SCCP(SSAForm *ssa);
+
+    void Run();
+
+    // Returns whether the code changed.
+    bool Apply();
+
+    int NumFolded() const { return folded; }
+
+    int NumBranches() const { return branches; }
+
+    int NumDropped() const { return dropped; }
+};
+
+#endif
@@ -0,0 +1,370 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include "codegen.h"
+#include "intern.h"
+#include "output.h"
+
+
+// Text form of the TAC, one instruction per line, close to what
+// --annotate prints. Every variable and temp carries its frame slot
+// (x@fp-8, g@gp+0, _tmp3@fp-20) so the code can be read back without
+// the symbol tables; labels are bare names and end in ':' when defined.
+//
+//   _f:
+//       BeginFunc 16
+//       _tmp0@fp-8 = *(this@fp+4 + 8)
+//       _tmp1@fp-12 = _tmp0@fp-8 + n@fp+8
+//       IfZ _tmp1@fp-12 Goto _L0
+//       _tmp2@fp-16 = LCall _g
+//       EndFunc
+//   VTable Foo = _Foo.m, _Foo.n
+
+static const char *SegmentName(Segment s) {
+    return s == gpRelative ? "gp" : "fp";
+}
+
+void CodeGenerator::WriteOperand(int id) {
+    Location *l = operands[id];
+    asmOut.Printf("%s@%s%+d", l->GetName(), SegmentName(l->GetSegment()),
+                  l->GetOffset());
+}
+
+void CodeGenerator::WriteTac() {
+    for (size_t f = 0; f < funcs.size(); f++) {
+        std::vector<TacInstr> &code = funcs[f]->code;
+        for (size_t i = 0; i < code.size(); i++) {
+            const TacInstr &ins = code[i];
+            if (ins.op == TacLabel) {
+                asmOut.Printf("%s:\n", labels[ins.imm]);
+                continue;
+            }
+            if (ins.op == TacVTable) {
+                List<const char *> *methods = vtables[ins.imm].second;
+                asmOut.Printf("VTable %s =", vtables[ins.imm].first);
+                for (int m = 0; m < methods->NumElements(); m++)
+                    asmOut.Printf("%s %s", m ? "," : "", methods->Nth(m));
+                asmOut.Printf("\n");
+                continue;
+            }
+
+            asmOut.Printf("    ");
+            if (ins.dst >= 0 && ins.op != TacStore) {
+                WriteOperand(ins.dst);
+                asmOut.Printf(" = ");
+            }
+            switch (ins.op) {
+                case TacLoadConstant:
+                    asmOut.Printf("%d", ins.imm);
+                    break;
+                case TacLoadStringLiteral:
+                    asmOut.Write(strings[ins.imm], strlen(strings[ins.imm]));
+                    break;
+                case TacLoadLabel:
+                    asmOut.Printf("%s", labels[ins.imm]);
+                    break;
+                case TacAssign:
+                    WriteOperand(ins.src1);
+                    break;
+                case TacLoad:
+                    asmOut.Printf("*(");
+                    WriteOperand(ins.src1);
+                    asmOut.Printf(" + %d)", ins.imm);
+                    break;
+                case TacStore:
+                    asmOut.Printf("*(");
+                    WriteOperand(ins.dst);
+                    asmOut.Printf(" + %d) = ", ins.imm);
+                    WriteOperand(ins.src1);
+                    break;
+                case TacBinaryOp:
+                    WriteOperand(ins.src1);
+                    asmOut.Printf(" %s ", BinaryOp::opName[ins.code]);
+                    WriteOperand(ins.src2);
+                    break;
+                case TacGoto:
+                    asmOut.Printf("Goto %s", labels[ins.imm]);
+                    break;
+                case TacIfZ:
+                    asmOut.Printf("IfZ ");
+                    WriteOperand(ins.src1);
+                    asmOut.Printf(" Goto %s", labels[ins.imm]);
+                    break;
+                case TacBeginFunc:
+                    asmOut.Printf("BeginFunc %d", ins.imm);
+                    break;
+                case TacEndFunc:
+                    asmOut.Printf("EndFunc");
+                    break;
+                case TacReturn:
+                    asmOut.Printf("Return");
+                    if (ins.src1 >= 0) {
+                        asmOut.Printf(" ");
+                        WriteOperand(ins.src1);
+                    }
+                    break;
+                case TacPushParam:
+                    asmOut.Printf("PushParam ");
+                    WriteOperand(ins.src1);
+                    break;
+                case TacPopParams:
+                    asmOut.Printf("PopParams %d", ins.imm);
+                    break;
+                case TacLCall:
+                    asmOut.Printf("LCall %s", labels[ins.imm]);
+                    break;
+                case TacACall:
+                    asmOut.Printf("ACall ");
+                    WriteOperand(ins.src1);
+                    break;
+            }
+            asmOut.Printf("\n");
+        }
+    }
+}
+
+
+// Splits off the next space-separated word, or NULL at the end.
+static char *NextWord(char *&p) {
+    while (*p == ' ' || *p == '\t') p++;
+    if (!*p) return NULL;
+    char *w = p;
+    while (*p && *p != ' ' && *p != '\t') p++;
+    if (*p) *p++ = '\0';
+    return w;
+}
+
+static bool ParseInt(const char *s, int *n) {
+    char *end;
+    if (!s) return false;
+    long v = strtol(s, &end, 10);
+    *n = (int) v;
+    return end != s && *end == '\0';
+}
+
+int CodeGenerator::ReadOperand(const char *word,
+                               Hashtable<Location *> &locs) {
+    if (!word) return -1;
+    const char *at = strchr(word, '@');
+    if (!at || at == word) return -1;
+    // fp-relative operands belong to the function being read, whose
+    // frame the optimizer may lay out again
+    char key[320];
+    if (strlen(word) > 300) return -1;
+    if (!strncmp(at + 1, "fp", 2))
+        sprintf(key, "%s#%d", word, NumFunctions());
+    else
+        strcpy(key, word);
+    Location *l = locs.Lookup(Intern(key));
+    if (l == NULL) {
+        int offset;
+        Segment seg;
+        if (!strncmp(at + 1, "fp", 2)) seg = fpRelative;
+        else if (!strncmp(at + 1, "gp", 2)) seg = gpRelative;
+        else return -1;
+        if (!ParseInt(at + 3, &offset)) return -1;
+
+        char name[256];
+        int len = at - word;
+        if (len >= (int) sizeof(name)) return -1;
+        memcpy(name, word, len);
+        name[len] = '\0';
+        int reg;
+        if (!strncmp(name, "_tmp", 4) && ParseInt(name + 4, &reg))
+            l = new Location(seg, offset, reg);
+        else
+            l = new Location(seg, offset, name);
+        locs.Enter(Intern(key), l);
+    }
+    return OperandId(l);
+}
+
+// Parses "*(a + n)" (or "*(a)") starting at p, leaving p after the ')'.
+bool CodeGenerator::ReadAddress(char *&p, Hashtable<Location *> &locs,
+                                int *base, int *offset) {
+    while (*p == ' ') p++;
+    if (strncmp(p, "*(", 2)) return false;
+    p += 2;
+    char *close = strchr(p, ')');
+    if (!close) return false;
+    *close = '\0';
+    char *inner = p;
+    p = close + 1;
+    *base = ReadOperand(NextWord(inner), locs);
+    *offset = 0;
+    char *plus = NextWord(inner);
+    if (plus && (strcmp(plus, "+") || !ParseInt(NextWord(inner), offset)))
+        return false;
+    return *base >= 0 && NextWord(inner) == NULL;
+}
+
+// Keeps what the generator would have recorded for a label it made:
+// calls to a builtin pull in its runtime routine, and NewLabel must not
+// hand out a _L number the text already uses.
+void CodeGenerator::NoteLabel(const char *label) {
+    int b = BuiltInForLabel(label);
+    if (b < NumBuiltIns) builtin_used[b] = true;
+    int n;
+    if (label[0] == '_' && label[1] == 'L' && ParseInt(label + 2, &n)
+        && n >= next_label)
+        next_label = n + 1;
+}
+
+bool CodeGenerator::ReadTacLine(char *p, Hashtable<Location *> &locs) {
+    int len = strlen(p);
+    if (!strchr(p, ' ') && len > 1 && p[len - 1] == ':') {
+        p[len - 1] = '\0';
+        NoteLabel(p);
+        Code(TacLabel).imm = LabelId(p);
+        return true;
+    }
+
+    if (!strncmp(p, "*(", 2)) {
+        int base, offset;
+        if (!ReadAddress(p, locs, &base, &offset)) return false;
+        char *eq = NextWord(p);
+        int src = ReadOperand(NextWord(p), locs);
+        if (!eq || strcmp(eq, "=") || src < 0 || NextWord(p)) return false;
+        TacInstr &ins = Code(TacStore);
+        ins.dst = base;
+        ins.src1 = src;
+        ins.imm = offset;
+        return true;
+    }
+
+    char *word = NextWord(p);
+    int dst = -1;
+    if (strchr(word, '@')) {
+        char *eq = NextWord(p);
+        dst = ReadOperand(word, locs);
+        if (dst < 0 || !eq || strcmp(eq, "=")) return false;
+        while (*p == ' ') p++;
+        if (*p == '"') {
+            if (p[strlen(p) - 1] != '"' || strlen(p) < 2) return false;
+            strings.push_back(strdup(p));
+            TacInstr &ins = Code(TacLoadStringLiteral);
+            ins.dst = dst;
+            ins.imm = strings.size() - 1;
+            return true;
+        }
+        if (!strncmp(p, "*(", 2)) {
+            int base, offset;
+            if (!ReadAddress(p, locs, &base, &offset) || NextWord(p))
+                return false;
+            TacInstr &ins = Code(TacLoad);
+            ins.dst = dst;
+            ins.src1 = base;
+            ins.imm = offset;
+            return true;
+        }
+        word = NextWord(p);
+        if (!word) return false;
+    }
+
+    int n;
+    char *arg = NextWord(p);
+    if (!strcmp(word, "LCall") && arg) {
+        NoteLabel(arg);
+        TacInstr &ins = Code(TacLCall);
+        ins.dst = dst;
+        ins.imm = LabelId(arg);
+    } else if (!strcmp(word, "ACall") && arg) {
+        TacInstr &ins = Code(TacACall);
+        ins.dst = dst;
+        if ((ins.src1 = ReadOperand(arg, locs)) < 0) return false;
+    } else if (dst >= 0 && !arg) {
+        if (ParseInt(word, &n)) {
+            TacInstr &ins = Code(TacLoadConstant);
+            ins.dst = dst;
+            ins.imm = n;
+        } else if (strchr(word, '@')) {
+            TacInstr &ins = Code(TacAssign);
+            ins.dst = dst;
+            ins.src1 = ReadOperand(word, locs);
+            if (ins.src1 < 0) return false;
+        } else {
+            TacInstr &ins = Code(TacLoadLabel);
+            ins.dst = dst;
+            ins.imm = LabelId(word);
+        }
+    } else if (dst >= 0) {
+        int op = 0;
+        while (op < BinaryOp::NumOps && strcmp(BinaryOp::opName[op], arg))
+            op++;
+        int src1 = ReadOperand(word, locs);
+        int src2 = ReadOperand(NextWord(p), locs);
+        if (op == BinaryOp::NumOps || src1 < 0 || src2 < 0) return false;
+        TacInstr &ins = Code(TacBinaryOp);
+        ins.code = op;
+        ins.dst = dst;
+        ins.src1 = src1;
+        ins.src2 = src2;
+    } else if (!strcmp(word, "Goto") && arg) {
+        NoteLabel(arg);
+        Code(TacGoto).imm = LabelId(arg);
+    } else if (!strcmp(word, "IfZ") && arg) {
+        int test = ReadOperand(arg, locs);
+        char *go = NextWord(p);
+        char *label = NextWord(p);
+        if (test < 0 || !go || strcmp(go, "Goto") || !label) return false;
+        NoteLabel(label);
+        TacInstr &ins = Code(TacIfZ);
+        ins.src1 = test;
+        ins.imm = LabelId(label);
+    } else if (!strcmp(word, "BeginFunc") && ParseInt(arg, &n)) {
+        Code(TacBeginFunc).imm = n;
+    } else if (!strcmp(word, "EndFunc") && !arg) {
+        Code(TacEndFunc);
+        funcs.back()->closed = true;
+    } else if (!strcmp(word, "Return")) {
+        int val = arg ? ReadOperand(arg, locs) : -1;
+        if (arg && val < 0) return false;
+        Code(TacReturn).src1 = val;
+    } else if (!strcmp(word, "PushParam") && arg) {
+        int val = ReadOperand(arg, locs);
+        if (val < 0) return false;
+        Code(TacPushParam).src1 = val;
+    } else if (!strcmp(word, "PopParams") && ParseInt(arg, &n)) {
+        Code(TacPopParams).imm = n;
+    } else if (!strcmp(word, "VTable") && arg) {
+        char *eq = NextWord(p);
+        if (!eq || strcmp(eq, "=")) return false;
+        List<const char *> *methods = new List<const char *>;
+        while ((word = NextWord(p)) != NULL) {
+            int wl = strlen(word);
+            if (word[wl - 1] == ',') word[wl - 1] = '\0';
+            methods->Append(Intern(word));
+        }
+        vtables.push_back(std::make_pair(Intern(arg), methods));
+        Code(TacVTable).imm = vtables.size() - 1;
+        funcs.back()->closed = true;
+    } else {
+        return false;
+    }
+    return NextWord(p) == NULL;
+}
+
+bool CodeGenerator::ReadTac(FILE *in) {
+    Hashtable<Location *> locs;
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+    int lineno = 0;
+    bool ok = true;
+
+    while (ok && (len = getline(&line, &cap, in)) >= 0) {
+        lineno++;
+        while (len > 0 && isspace((unsigned char) line[len - 1]))
+            line[--len] = '\0';
+        char *p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (!*p || *p == '#') continue;
+        if (!ReadTacLine(p, locs)) {
+            fprintf(stderr, "line %d: bad TAC\n", lineno);
+            ok = false;
+        }
+    }
+    free(line);
+    return ok;
+}